@@ -0,0 +1,321 @@
+#include "db-dump.h"
+
+#include <cstring>
+#include <memory>
+#include <zlib.h>
+#include <leveldb/env.h>
+#include <leveldb/write_batch.h>
+#include "indexed-db.h"
+#include "util/crc32c.h"
+
+namespace {
+
+const char kMagic[] = "RNLDBDMP";
+const size_t kMagicSize = 8;
+const uint32_t kVersion = 1;
+
+// Every chunk starts with a header: type (1 byte), raw size, stored size, masked CRC32C of the stored bytes
+// (fixed32 each).
+const size_t kChunkHeaderSize = 13;
+const char kChunkRaw = 0;
+const char kChunkZlib = 1;
+const char kChunkEnd = 2;  // Holds the number of entries in the dump, as a fixed64.
+
+const size_t kChunkSize = 256 << 10;
+const size_t kImportBatchSize = 4 << 20;
+// Upper bound for the size of a chunk while importing. A single entry can exceed kChunkSize, so this is not tight;
+// it only stops a corrupt header from causing a huge allocation.
+const uint32_t kMaxChunkSize = 256 << 20;
+// Upper bound for the size of the key and value of an entry, so that every chunk the export writes is within
+// kMaxChunkSize: a chunk is flushed once it reaches kChunkSize, and an entry adds two varint32 sizes (up to 10 bytes).
+const size_t kMaxEntrySize = kMaxChunkSize - kChunkSize - 10;
+
+void putFixed32(std::string* dst, uint32_t value) {
+  for (int i = 0; i < 4; ++i) {
+    dst->push_back((char)(value >> (8 * i)));
+  }
+}
+
+uint32_t decodeFixed32(const char* ptr) {
+  uint32_t value = 0;
+  for (int i = 0; i < 4; ++i) {
+    value |= (uint32_t)(unsigned char)ptr[i] << (8 * i);
+  }
+  return value;
+}
+
+void putVarint32(std::string* dst, uint32_t value) {
+  while (value >= 0x80) {
+    dst->push_back((char)(value | 0x80));
+    value >>= 7;
+  }
+  dst->push_back((char)value);
+}
+
+bool getVarint32(leveldb::Slice* input, uint32_t* value) {
+  *value = 0;
+  for (int shift = 0; shift <= 28 && !input->empty(); shift += 7) {
+    uint32_t byte = (unsigned char)(*input)[0];
+    input->remove_prefix(1);
+    *value |= (byte & 0x7f) << shift;
+    if (!(byte & 0x80)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+leveldb::Status writeChunk(leveldb::WritableFile* file, char type, const std::string& raw, bool compress) {
+  std::string stored;
+  if (compress) {
+    uLongf storedSize = compressBound(raw.size());
+    stored.resize(storedSize);
+    // Level 1 is much faster than the default, for only a slightly worse ratio.
+    if (compress2((Bytef*)&stored[0], &storedSize, (const Bytef*)raw.data(), raw.size(), 1) == Z_OK &&
+        storedSize < raw.size()) {
+      stored.resize(storedSize);
+    } else {
+      compress = false;
+    }
+  }
+  const std::string& payload = compress ? stored : raw;
+
+  std::string header(1, compress ? kChunkZlib : type);
+  putFixed32(&header, (uint32_t)raw.size());
+  putFixed32(&header, (uint32_t)payload.size());
+  putFixed32(&header, leveldb::crc32c::Mask(leveldb::crc32c::Value(payload.data(), payload.size())));
+  leveldb::Status status = file->Append(header);
+  if (status.ok()) {
+    status = file->Append(payload);
+  }
+  return status;
+}
+
+// Reads exactly `n` bytes into `scratch`.
+leveldb::Status readFully(leveldb::SequentialFile* file, size_t n, std::string* scratch) {
+  scratch->resize(n);
+  size_t read = 0;
+  while (read < n) {
+    leveldb::Slice result;
+    leveldb::Status status = file->Read(n - read, &result, &(*scratch)[read]);
+    if (!status.ok()) {
+      return status;
+    }
+    if (result.empty()) {
+      return leveldb::Status::Corruption("dump file is truncated");
+    }
+    if (result.data() != &(*scratch)[read]) {
+      memcpy(&(*scratch)[read], result.data(), result.size());
+    }
+    read += result.size();
+  }
+  return leveldb::Status::OK();
+}
+
+}  // namespace
+
+leveldb::Status ExportDump(leveldb::DB* db, const std::string& path, bool compress, DumpProgress* progress) {
+  leveldb::Env* env = leveldb::Env::Default();
+  std::string tmpPath = path + ".tmp";
+  leveldb::WritableFile* rawFile;
+  leveldb::Status status = env->NewWritableFile(tmpPath, &rawFile);
+  if (!status.ok()) {
+    return status;
+  }
+  std::unique_ptr<leveldb::WritableFile> file(rawFile);
+
+  std::string header(kMagic, kMagicSize);
+  putFixed32(&header, kVersion);
+  status = file->Append(header);
+
+  leveldb::ReadOptions readOptions;
+  readOptions.fill_cache = false;
+  readOptions.snapshot = db->GetSnapshot();
+  std::unique_ptr<leveldb::Iterator> it(db->NewIterator(readOptions));
+  std::string chunk;
+  uint64_t entries = 0;
+  for (it->SeekToFirst(); status.ok() && it->Valid(); it->Next()) {
+    if (it->key().size() + it->value().size() > kMaxEntrySize) {
+      status = leveldb::Status::NotSupported("an entry is too large to be dumped",
+                                             std::to_string(it->key().size() + it->value().size()) + " bytes");
+      break;
+    }
+    putVarint32(&chunk, (uint32_t)it->key().size());
+    chunk.append(it->key().data(), it->key().size());
+    putVarint32(&chunk, (uint32_t)it->value().size());
+    chunk.append(it->value().data(), it->value().size());
+    ++entries;
+    if (chunk.size() >= kChunkSize) {
+      status = writeChunk(file.get(), kChunkRaw, chunk, compress);
+      progress->entries = entries;
+      progress->bytes += chunk.size();
+      chunk.clear();
+    }
+  }
+  if (status.ok()) {
+    status = it->status();
+  }
+  it.reset();
+  db->ReleaseSnapshot(readOptions.snapshot);
+
+  if (status.ok() && !chunk.empty()) {
+    status = writeChunk(file.get(), kChunkRaw, chunk, compress);
+    progress->entries = entries;
+    progress->bytes += chunk.size();
+  }
+  if (status.ok()) {
+    std::string end;
+    putFixed32(&end, (uint32_t)entries);
+    putFixed32(&end, (uint32_t)(entries >> 32));
+    status = writeChunk(file.get(), kChunkEnd, end, false);
+  }
+  if (status.ok()) {
+    status = file->Sync();
+  }
+  if (status.ok()) {
+    status = file->Close();
+  }
+  file.reset();
+
+  if (status.ok()) {
+    status = env->RenameFile(tmpPath, path);
+  } else {
+    env->RemoveFile(tmpPath);
+  }
+  return status;
+}
+
+namespace {
+
+// Calls onEntry(key, value) for every entry of the dump at `path`, stopping at the first error it returns, and
+// onChunk(chunk size) after every chunk.
+template <typename EntryFn, typename ChunkFn>
+leveldb::Status readDump(const std::string& path, EntryFn onEntry, ChunkFn onChunk) {
+  leveldb::SequentialFile* rawFile;
+  leveldb::Status status = leveldb::Env::Default()->NewSequentialFile(path, &rawFile);
+  if (!status.ok()) {
+    return status;
+  }
+  std::unique_ptr<leveldb::SequentialFile> file(rawFile);
+
+  std::string scratch;
+  status = readFully(file.get(), kMagicSize + 4, &scratch);
+  if (!status.ok()) {
+    return status;
+  }
+  if (scratch.compare(0, kMagicSize, kMagic) != 0) {
+    return leveldb::Status::Corruption(path, "not a dump file");
+  }
+  if (decodeFixed32(&scratch[kMagicSize]) != kVersion) {
+    return leveldb::Status::NotSupported(path, "unknown dump version");
+  }
+
+  std::string stored, raw;
+  uint64_t entries = 0;
+  while (true) {
+    status = readFully(file.get(), kChunkHeaderSize, &scratch);
+    if (!status.ok()) {
+      return status;
+    }
+    char type = scratch[0];
+    uint32_t rawSize = decodeFixed32(&scratch[1]);
+    uint32_t storedSize = decodeFixed32(&scratch[5]);
+    uint32_t crc = leveldb::crc32c::Unmask(decodeFixed32(&scratch[9]));
+    if (rawSize > kMaxChunkSize || storedSize > kMaxChunkSize) {
+      return leveldb::Status::Corruption(path, "invalid chunk size");
+    }
+    status = readFully(file.get(), storedSize, &stored);
+    if (!status.ok()) {
+      return status;
+    }
+    if (leveldb::crc32c::Value(stored.data(), stored.size()) != crc) {
+      return leveldb::Status::Corruption(path, "checksum mismatch");
+    }
+
+    if (type == kChunkEnd) {
+      if (stored.size() != 8) {
+        return leveldb::Status::Corruption(path, "invalid end chunk");
+      }
+      uint64_t expected = decodeFixed32(&stored[0]) | (uint64_t)decodeFixed32(&stored[4]) << 32;
+      if (expected != entries) {
+        return leveldb::Status::Corruption(path, "entry count mismatch");
+      }
+      return leveldb::Status::OK();
+    }
+    if (type == kChunkZlib) {
+      raw.resize(rawSize);
+      uLongf size = rawSize;
+      if (uncompress((Bytef*)&raw[0], &size, (const Bytef*)stored.data(), stored.size()) != Z_OK || size != rawSize) {
+        return leveldb::Status::Corruption(path, "invalid compressed chunk");
+      }
+    } else if (type == kChunkRaw) {
+      raw.swap(stored);
+    } else {
+      return leveldb::Status::Corruption(path, "unknown chunk type");
+    }
+
+    leveldb::Slice input(raw);
+    while (!input.empty()) {
+      uint32_t keySize, valueSize;
+      if (!getVarint32(&input, &keySize) || input.size() < keySize) {
+        return leveldb::Status::Corruption(path, "invalid entry");
+      }
+      leveldb::Slice key(input.data(), keySize);
+      input.remove_prefix(keySize);
+      if (!getVarint32(&input, &valueSize) || input.size() < valueSize) {
+        return leveldb::Status::Corruption(path, "invalid entry");
+      }
+      status = onEntry(key, leveldb::Slice(input.data(), valueSize));
+      if (!status.ok()) {
+        return status;
+      }
+      input.remove_prefix(valueSize);
+      ++entries;
+    }
+    status = onChunk(raw.size());
+    if (!status.ok()) {
+      return status;
+    }
+  }
+}
+
+}  // namespace
+
+leveldb::Status ImportDump(leveldb::DB* db, const std::string& path, DumpProgress* progress) {
+  // The whole dump is checked first, so that a corrupt one is rejected before anything is written. Keys in the range
+  // reserved for indexes are rejected here too: otherwise, whether they fail depends on whether `db` has indexes.
+  leveldb::Status status = readDump(
+      path,
+      [&](const leveldb::Slice& key, const leveldb::Slice& value) {
+        return IndexedDB::IsReservedKey(key) ? leveldb::Status::Corruption(path, "reserved key")
+                                             : leveldb::Status::OK();
+      },
+      [](size_t chunkSize) { return leveldb::Status::OK(); });
+  if (!status.ok()) {
+    return status;
+  }
+
+  leveldb::WriteBatch batch;
+  uint64_t entries = 0;
+  status = readDump(
+      path,
+      [&](const leveldb::Slice& key, const leveldb::Slice& value) {
+        batch.Put(key, value);
+        ++entries;
+        return leveldb::Status::OK();
+      },
+      [&](size_t chunkSize) {
+        progress->entries = entries;
+        progress->bytes += chunkSize;
+        if (batch.ApproximateSize() < kImportBatchSize) {
+          return leveldb::Status::OK();
+        }
+        leveldb::Status writeStatus = db->Write(leveldb::WriteOptions(), &batch);
+        batch.Clear();
+        return writeStatus;
+      });
+  if (!status.ok()) {
+    return status;
+  }
+  return db->Write(leveldb::WriteOptions(), &batch);
+}
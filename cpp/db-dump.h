@@ -0,0 +1,26 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <leveldb/db.h>
+
+// Progress of an export or import; it is updated while the dump runs and can be read from other threads.
+struct DumpProgress {
+  std::atomic<uint64_t> entries{0};
+  std::atomic<uint64_t> bytes{0};  // Bytes of keys and values, before compression.
+};
+
+// Writes all entries of `db`, as of a snapshot taken when the export starts, into a dump file at `path`.
+//
+// A dump is an 8 byte magic and a version, followed by chunks of about 256KB of sorted key/value pairs. Every chunk
+// carries a CRC32C checksum and is optionally compressed with zlib. The final chunk holds the number of entries,
+// so that a truncated dump is detected. The file is written under a temporary name and renamed when complete.
+// Entries whose key and value are larger than about 256MB together can't be imported, so the export fails on them.
+leveldb::Status ExportDump(leveldb::DB* db, const std::string& path, bool compress, DumpProgress* progress);
+
+// Writes all entries of the dump file at `path` into `db`, overwriting existing keys. The whole dump is validated
+// before anything is written: a corrupt dump, or one holding keys reserved for indexes (see IndexedDB), is rejected
+// as a whole. Entries are written in large unsynced batches, which is much faster for bulk loads; if a write fails
+// halfway, the entries of the batches written up to then remain.
+leveldb::Status ImportDump(leveldb::DB* db, const std::string& path, DumpProgress* progress);
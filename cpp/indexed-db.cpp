@@ -0,0 +1,826 @@
+#include "indexed-db.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <leveldb/write_batch.h>
+
+namespace {
+
+const std::string kReservedPrefix("\xff\xffidx:", 6);
+const std::string kReservedEnd("\xff\xffidx;", 6);  // The first key after all keys starting with kReservedPrefix.
+const std::string kDefPrefix = kReservedPrefix + "def:";  // + index name -> serialized IndexDef
+const std::string kEntryPrefix = kReservedPrefix + "ent:";  // + index name + \0 + escaped field + key -> key
+
+// Field type tags; their order is the order of the types in an index.
+const char kTagNull = 1;
+const char kTagFalse = 2;
+const char kTagTrue = 3;
+const char kTagNumber = 4;
+const char kTagString = 5;
+
+const int kMaxJsonDepth = 64;
+const size_t kBatchSize = 1 << 20;
+
+bool startsWith(const leveldb::Slice& s, const std::string& prefix) {
+  return s.size() >= prefix.size() && memcmp(s.data(), prefix.data(), prefix.size()) == 0;
+}
+
+std::string entryBase(const std::string& name) {
+  return kEntryPrefix + name + '\0';
+}
+
+// Escapes \0 bytes, so that fields are followed by a terminator that sorts before any continuation:
+// field + "\0\1" < field + "\0\2" < field + "\0\xff" (an escaped \0) < field + any other byte.
+std::string escapeField(const std::string& field) {
+  std::string escaped;
+  for (char c : field) {
+    escaped.push_back(c);
+    if (c == '\0') {
+      escaped.push_back('\xff');
+    }
+  }
+  return escaped;
+}
+
+std::string entryKey(const std::string& name, const std::string& field, const leveldb::Slice& key) {
+  return entryBase(name) + escapeField(field) + std::string("\0\1", 2) + key.ToString();
+}
+
+// Just enough of a JSON parser to find a scalar at a path without building a document.
+class JsonReader {
+ public:
+  explicit JsonReader(const leveldb::Slice& input) : p_(input.data()), end_(input.data() + input.size()) {}
+
+  // Finds the value at `path` and encodes it into `field`. Returns false if there is no scalar at `path`.
+  bool Extract(const std::vector<std::string>& path, std::string* field) {
+    for (auto& segment : path) {
+      SkipWhitespace();
+      if (Consume('{')) {
+        if (!FindMember(segment)) {
+          return false;
+        }
+      } else if (Consume('[')) {
+        char* end;
+        long index = std::strtol(segment.c_str(), &end, 10);
+        if (segment.empty() || *end || index < 0 || !FindElement(index)) {
+          return false;
+        }
+      } else {
+        return false;
+      }
+    }
+
+    SkipWhitespace();
+    if (p_ < end_ && *p_ == '"') {
+      std::string str;
+      if (!ParseString(&str)) {
+        return false;
+      }
+      *field = IndexedDB::EncodeString(str);
+      return true;
+    }
+    const char* start = p_;
+    SkipScalar();
+    std::string token(start, p_ - start);
+    if (token == "null") {
+      *field = IndexedDB::EncodeNull();
+    } else if (token == "true" || token == "false") {
+      *field = IndexedDB::EncodeBool(token == "true");
+    } else {
+      char* end;
+      double number = std::strtod(token.c_str(), &end);
+      if (token.empty() || *end || !std::isfinite(number)) {
+        return false;
+      }
+      *field = IndexedDB::EncodeNumber(number);
+    }
+    return true;
+  }
+
+ private:
+  void SkipWhitespace() {
+    while (p_ < end_ && (*p_ == ' ' || *p_ == '\t' || *p_ == '\n' || *p_ == '\r')) {
+      ++p_;
+    }
+  }
+
+  bool Consume(char c) {
+    if (p_ < end_ && *p_ == c) {
+      ++p_;
+      return true;
+    }
+    return false;
+  }
+
+  // Advances past a number or literal.
+  void SkipScalar() {
+    while (p_ < end_ && (isalnum((unsigned char)*p_) || *p_ == '-' || *p_ == '+' || *p_ == '.')) {
+      ++p_;
+    }
+  }
+
+  // Positions after the ':' of member `name` of the object just opened.
+  bool FindMember(const std::string& name) {
+    SkipWhitespace();
+    if (Consume('}')) {
+      return false;
+    }
+    while (true) {
+      std::string key;
+      SkipWhitespace();
+      if (!ParseString(&key)) {
+        return false;
+      }
+      SkipWhitespace();
+      if (!Consume(':')) {
+        return false;
+      }
+      if (key == name) {
+        return true;
+      }
+      if (!SkipValue(0)) {
+        return false;
+      }
+      SkipWhitespace();
+      if (!Consume(',')) {
+        return false;
+      }
+    }
+  }
+
+  // Positions before element `index` of the array just opened.
+  bool FindElement(long index) {
+    SkipWhitespace();
+    if (p_ < end_ && *p_ == ']') {
+      return false;
+    }
+    for (long i = 0; i < index; ++i) {
+      if (!SkipValue(0)) {
+        return false;
+      }
+      SkipWhitespace();
+      if (!Consume(',')) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  bool SkipValue(int depth) {
+    if (depth > kMaxJsonDepth) {
+      return false;
+    }
+    SkipWhitespace();
+    if (p_ >= end_) {
+      return false;
+    }
+    if (*p_ == '"') {
+      return ParseString(nullptr);
+    }
+    if (Consume('{') || Consume('[')) {
+      char close = p_[-1] == '{' ? '}' : ']';
+      SkipWhitespace();
+      if (Consume(close)) {
+        return true;
+      }
+      while (true) {
+        if (close == '}') {
+          SkipWhitespace();
+          if (!ParseString(nullptr)) {
+            return false;
+          }
+          SkipWhitespace();
+          if (!Consume(':')) {
+            return false;
+          }
+        }
+        if (!SkipValue(depth + 1)) {
+          return false;
+        }
+        SkipWhitespace();
+        if (Consume(close)) {
+          return true;
+        }
+        if (!Consume(',')) {
+          return false;
+        }
+      }
+    }
+    const char* start = p_;
+    SkipScalar();
+    return p_ > start;
+  }
+
+  static void AppendUtf8(uint32_t cp, std::string* out) {
+    if (cp < 0x80) {
+      out->push_back((char)cp);
+    } else if (cp < 0x800) {
+      out->push_back((char)(0xc0 | (cp >> 6)));
+      out->push_back((char)(0x80 | (cp & 0x3f)));
+    } else if (cp < 0x10000) {
+      out->push_back((char)(0xe0 | (cp >> 12)));
+      out->push_back((char)(0x80 | ((cp >> 6) & 0x3f)));
+      out->push_back((char)(0x80 | (cp & 0x3f)));
+    } else {
+      out->push_back((char)(0xf0 | (cp >> 18)));
+      out->push_back((char)(0x80 | ((cp >> 12) & 0x3f)));
+      out->push_back((char)(0x80 | ((cp >> 6) & 0x3f)));
+      out->push_back((char)(0x80 | (cp & 0x3f)));
+    }
+  }
+
+  bool ParseHex4(uint32_t* value) {
+    if (end_ - p_ < 4) {
+      return false;
+    }
+    char hex[5] = {p_[0], p_[1], p_[2], p_[3], 0};
+    char* end;
+    *value = (uint32_t)std::strtoul(hex, &end, 16);
+    p_ += 4;
+    return *end == '\0';
+  }
+
+  // Parses a string, unescaping it into `out` unless that's null.
+  bool ParseString(std::string* out) {
+    if (!Consume('"')) {
+      return false;
+    }
+    while (p_ < end_) {
+      char c = *p_++;
+      if (c == '"') {
+        return true;
+      }
+      if (c != '\\') {
+        if (out) {
+          out->push_back(c);
+        }
+        continue;
+      }
+      if (p_ >= end_) {
+        return false;
+      }
+      c = *p_++;
+      uint32_t cp;
+      switch (c) {
+        case 'b': cp = '\b'; break;
+        case 'f': cp = '\f'; break;
+        case 'n': cp = '\n'; break;
+        case 'r': cp = '\r'; break;
+        case 't': cp = '\t'; break;
+        case 'u':
+          if (!ParseHex4(&cp)) {
+            return false;
+          }
+          // A surrogate pair encodes one code point outside the BMP.
+          if (cp >= 0xd800 && cp < 0xdc00 && end_ - p_ >= 6 && p_[0] == '\\' && p_[1] == 'u') {
+            const char* save = p_;
+            p_ += 2;
+            uint32_t low;
+            if (ParseHex4(&low) && low >= 0xdc00 && low < 0xe000) {
+              cp = 0x10000 + ((cp - 0xd800) << 10) + (low - 0xdc00);
+            } else {
+              p_ = save;
+            }
+          }
+          break;
+        default: cp = (unsigned char)c; break;  // \" \\ \/
+      }
+      if (out) {
+        AppendUtf8(cp, out);
+      }
+    }
+    return false;
+  }
+
+  const char* p_;
+  const char* end_;
+};
+
+// Hides the keys starting with kReservedPrefix; they are all adjacent, so one seek skips them.
+class UserKeyIterator : public leveldb::Iterator {
+ public:
+  explicit UserKeyIterator(leveldb::Iterator* it) : it_(it) {}
+
+  bool Valid() const override {
+    return it_->Valid();
+  }
+  void SeekToFirst() override {
+    it_->SeekToFirst();
+    SkipForward();
+  }
+  void SeekToLast() override {
+    it_->SeekToLast();
+    SkipBackward();
+  }
+  void Seek(const leveldb::Slice& target) override {
+    it_->Seek(target);
+    SkipForward();
+  }
+  void Next() override {
+    it_->Next();
+    SkipForward();
+  }
+  void Prev() override {
+    it_->Prev();
+    SkipBackward();
+  }
+  leveldb::Slice key() const override {
+    return it_->key();
+  }
+  leveldb::Slice value() const override {
+    return it_->value();
+  }
+  leveldb::Status status() const override {
+    return it_->status();
+  }
+
+ private:
+  void SkipForward() {
+    if (it_->Valid() && startsWith(it_->key(), kReservedPrefix)) {
+      it_->Seek(kReservedEnd);
+    }
+  }
+  void SkipBackward() {
+    if (it_->Valid() && startsWith(it_->key(), kReservedPrefix)) {
+      it_->Seek(kReservedPrefix);
+      it_->Prev();
+    }
+  }
+
+  std::unique_ptr<leveldb::Iterator> it_;
+};
+
+bool extractField(const IndexDef& def, const leveldb::Slice& value, std::string* field) {
+  if (def.type == IndexDef::kBytes) {
+    if ((uint64_t)def.byteOffset + def.byteLength > value.size()) {
+      return false;
+    }
+    *field = IndexedDB::EncodeString(leveldb::Slice(value.data() + def.byteOffset, def.byteLength));
+    return true;
+  }
+  return JsonReader(value).Extract(def.jsonPath, field);
+}
+
+}  // namespace
+
+IndexDef IndexDef::Json(const std::string& path) {
+  IndexDef def;
+  def.type = kJson;
+  size_t start = 0;
+  while (true) {
+    size_t dot = path.find('.', start);
+    def.jsonPath.push_back(path.substr(start, dot - start));
+    if (dot == std::string::npos) {
+      return def;
+    }
+    start = dot + 1;
+  }
+}
+
+IndexDef IndexDef::Bytes(uint32_t offset, uint32_t length) {
+  IndexDef def;
+  def.type = kBytes;
+  def.byteOffset = offset;
+  def.byteLength = length;
+  return def;
+}
+
+// Serialized as "json\n" + the path segments joined by \0, or "bytes\n" + offset + "\n" + length.
+std::string IndexDef::Serialize() const {
+  if (type == kBytes) {
+    return "bytes\n" + std::to_string(byteOffset) + "\n" + std::to_string(byteLength);
+  }
+  std::string serialized = "json\n";
+  for (size_t i = 0; i < jsonPath.size(); ++i) {
+    if (i) {
+      serialized.push_back('\0');
+    }
+    serialized += jsonPath[i];
+  }
+  return serialized;
+}
+
+bool IndexDef::Parse(const leveldb::Slice& serialized, IndexDef* def) {
+  std::string s = serialized.ToString();
+  *def = IndexDef();
+  if (s.compare(0, 5, "json\n") == 0) {
+    def->type = kJson;
+    size_t start = 5;
+    while (true) {
+      size_t sep = s.find('\0', start);
+      def->jsonPath.push_back(s.substr(start, sep - start));
+      if (sep == std::string::npos) {
+        return true;
+      }
+      start = sep + 1;
+    }
+  }
+  if (s.compare(0, 6, "bytes\n") == 0) {
+    def->type = kBytes;
+    char* end;
+    def->byteOffset = (uint32_t)std::strtoul(s.c_str() + 6, &end, 10);
+    if (*end != '\n') {
+      return false;
+    }
+    def->byteLength = (uint32_t)std::strtoul(end + 1, &end, 10);
+    return *end == '\0';
+  }
+  return false;
+}
+
+bool IndexDef::operator==(const IndexDef& other) const {
+  return type == other.type && jsonPath == other.jsonPath && byteOffset == other.byteOffset &&
+         byteLength == other.byteLength;
+}
+
+std::string IndexedDB::EncodeNull() {
+  return std::string(1, kTagNull);
+}
+
+std::string IndexedDB::EncodeBool(bool value) {
+  return std::string(1, value ? kTagTrue : kTagFalse);
+}
+
+// Big-endian IEEE 754 bits, with the sign bit flipped for positive numbers and all bits flipped for negative ones,
+// sort like the numbers themselves.
+std::string IndexedDB::EncodeNumber(double value) {
+  if (value == 0) {
+    value = 0;  // Normalizes -0.
+  }
+  uint64_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  bits = (bits & (1ull << 63)) ? ~bits : bits | (1ull << 63);
+  std::string field(1, kTagNumber);
+  for (int i = 7; i >= 0; --i) {
+    field.push_back((char)(bits >> (8 * i)));
+  }
+  return field;
+}
+
+std::string IndexedDB::EncodeString(const leveldb::Slice& value) {
+  return std::string(1, kTagString) + value.ToString();
+}
+
+bool IndexedDB::IsReservedKey(const leveldb::Slice& key) {
+  return startsWith(key, kReservedPrefix);
+}
+
+leveldb::Status IndexedDB::Open(leveldb::DB* db, bool indexable, IndexedDB** dbptr) {
+  std::unique_ptr<IndexedDB> indexed(new IndexedDB(db, indexable));
+  std::unique_ptr<leveldb::Iterator> it(db->NewIterator(leveldb::ReadOptions()));
+  for (it->Seek(kDefPrefix); it->Valid() && startsWith(it->key(), kDefPrefix); it->Next()) {
+    IndexDef def;
+    if (!IndexDef::Parse(it->value(), &def)) {
+      return leveldb::Status::Corruption("invalid index definition", it->key());
+    }
+    indexed->indexes_[it->key().ToString().substr(kDefPrefix.size())] = def;
+  }
+  if (!it->status().ok()) {
+    return it->status();
+  }
+  it.reset();
+  indexed->hasIndexes_ = !indexed->indexes_.empty();
+  *dbptr = indexed.release();
+  return leveldb::Status::OK();
+}
+
+leveldb::Status IndexedDB::ClearIndexEntries(const std::string& name) {
+  std::string base = entryBase(name);
+  leveldb::ReadOptions readOptions;
+  readOptions.fill_cache = false;
+  std::unique_ptr<leveldb::Iterator> it(db_->NewIterator(readOptions));
+  leveldb::WriteBatch batch;
+  for (it->Seek(base); it->Valid() && startsWith(it->key(), base); it->Next()) {
+    batch.Delete(it->key());
+    if (batch.ApproximateSize() >= kBatchSize) {
+      leveldb::Status status = db_->Write(leveldb::WriteOptions(), &batch);
+      if (!status.ok()) {
+        return status;
+      }
+      batch.Clear();
+    }
+  }
+  if (!it->status().ok()) {
+    return it->status();
+  }
+  return db_->Write(leveldb::WriteOptions(), &batch);
+}
+
+leveldb::Status IndexedDB::CreateIndex(const std::string& name, const IndexDef& def) {
+  if (!indexable_) {
+    return leveldb::Status::NotSupported("indexes need atomic writes, which sharded DBs don't have");
+  }
+  if (name.empty() || name.find('\0') != std::string::npos) {
+    return leveldb::Status::InvalidArgument("invalid index name", name);
+  }
+
+  // Holding the mutex blocks all writes on the indexed path while the existing records are indexed; the writes that
+  // already started on the unindexed path are waited for.
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto existing = indexes_.find(name);
+  if (existing != indexes_.end() && existing->second == def) {
+    return leveldb::Status::OK();
+  }
+  hasIndexes_ = true;
+  while (unindexedWrites_ > 0) {
+    std::this_thread::yield();
+  }
+  leveldb::Status status = BuildIndex(name, def);
+  hasIndexes_ = !indexes_.empty();
+  return status;
+}
+
+leveldb::Status IndexedDB::BuildIndex(const std::string& name, const IndexDef& def) {
+  // An existing definition is dropped first, and the new one is written last: until then, a crash or an error leaves
+  // no index (only stray entries, cleared on the next attempt to define it).
+  leveldb::Status status;
+  if (indexes_.count(name)) {
+    status = db_->Delete(leveldb::WriteOptions(), kDefPrefix + name);
+    if (!status.ok()) {
+      return status;
+    }
+    indexes_.erase(name);
+  }
+  status = ClearIndexEntries(name);
+  if (!status.ok()) {
+    return status;
+  }
+
+  leveldb::ReadOptions readOptions;
+  readOptions.fill_cache = false;
+  std::unique_ptr<leveldb::Iterator> it(NewIterator(readOptions));
+  leveldb::WriteBatch batch;
+  std::string field;
+  for (it->SeekToFirst(); it->Valid(); it->Next()) {
+    if (extractField(def, it->value(), &field)) {
+      batch.Put(entryKey(name, field, it->key()), it->key());
+    }
+    if (batch.ApproximateSize() >= kBatchSize) {
+      status = db_->Write(leveldb::WriteOptions(), &batch);
+      if (!status.ok()) {
+        return status;
+      }
+      batch.Clear();
+    }
+  }
+  if (!it->status().ok()) {
+    return it->status();
+  }
+
+  batch.Put(kDefPrefix + name, def.Serialize());
+  status = db_->Write(leveldb::WriteOptions(), &batch);
+  if (status.ok()) {
+    indexes_[name] = def;
+  }
+  return status;
+}
+
+leveldb::Status IndexedDB::DropIndex(const std::string& name) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!indexes_.count(name)) {
+    return leveldb::Status::NotFound("unknown index", name);
+  }
+  leveldb::Status status = db_->Delete(leveldb::WriteOptions(), kDefPrefix + name);
+  if (!status.ok()) {
+    return status;
+  }
+  indexes_.erase(name);
+  hasIndexes_ = !indexes_.empty();
+  return ClearIndexEntries(name);
+}
+
+leveldb::Status IndexedDB::Scan(const std::string& index, const IndexQuery& query, int limit,
+                                std::vector<std::pair<std::string, std::string>>* records) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!indexes_.count(index)) {
+      return leveldb::Status::NotFound("unknown index", index);
+    }
+  }
+
+  // All entries for one field value lie in [field + "\0\1", field + "\0\2"), see escapeField.
+  std::string base = entryBase(index);
+  std::string start = base, end = kEntryPrefix + index + '\1';
+  if (query.gte) {
+    start = std::max(start, base + escapeField(*query.gte) + std::string("\0\1", 2));
+  }
+  if (query.gt) {
+    start = std::max(start, base + escapeField(*query.gt) + std::string("\0\2", 2));
+  }
+  if (query.lt) {
+    end = std::min(end, base + escapeField(*query.lt) + std::string("\0\1", 2));
+  }
+  if (query.lte) {
+    end = std::min(end, base + escapeField(*query.lte) + std::string("\0\2", 2));
+  }
+
+  leveldb::ReadOptions readOptions;
+  readOptions.snapshot = db_->GetSnapshot();
+  std::unique_ptr<leveldb::Iterator> it(db_->NewIterator(readOptions));
+  leveldb::Status status;
+  std::string value;
+  for (it->Seek(start); it->Valid() && it->key().compare(end) < 0 && (limit <= 0 || records->size() < (size_t)limit);
+       it->Next()) {
+    status = db_->Get(readOptions, it->value(), &value);
+    if (status.IsNotFound()) {
+      continue;
+    }
+    if (!status.ok()) {
+      break;
+    }
+    records->emplace_back(it->value().ToString(), value);
+  }
+  if (status.ok() || status.IsNotFound()) {
+    status = it->status();
+  }
+  it.reset();
+  db_->ReleaseSnapshot(readOptions.snapshot);
+  return status;
+}
+
+leveldb::Status IndexedDB::AddIndexedUpdates(leveldb::WriteBatch* updates, leveldb::WriteBatch* out) {
+  // Collects the operations of a batch in order.
+  class Collector : public leveldb::WriteBatch::Handler {
+   public:
+    void Put(const leveldb::Slice& key, const leveldb::Slice& value) override {
+      ops.emplace_back(key.ToString(), value.ToString());
+    }
+    void Delete(const leveldb::Slice& key) override {
+      ops.emplace_back(key.ToString(), std::nullopt);
+    }
+    std::vector<std::pair<std::string, std::optional<std::string>>> ops;
+  };
+
+  Collector collector;
+  leveldb::Status status = updates->Iterate(&collector);
+  if (!status.ok()) {
+    return status;
+  }
+
+  // Values written earlier in the same batch take precedence over the ones in the DB.
+  std::map<std::string, std::optional<std::string>> pending;
+  std::string oldField, newField;
+  for (auto& [key, value] : collector.ops) {
+    if (!indexes_.empty()) {
+      std::optional<std::string> old;
+      auto found = pending.find(key);
+      if (found != pending.end()) {
+        old = found->second;
+      } else {
+        std::string oldValue;
+        status = db_->Get(leveldb::ReadOptions(), key, &oldValue);
+        if (status.ok()) {
+          old = std::move(oldValue);
+        } else if (!status.IsNotFound()) {
+          return status;
+        }
+      }
+
+      for (auto& [name, def] : indexes_) {
+        bool hasOld = old && extractField(def, *old, &oldField);
+        bool hasNew = value && extractField(def, *value, &newField);
+        if (hasOld && hasNew && oldField == newField) {
+          continue;
+        }
+        if (hasOld) {
+          out->Delete(entryKey(name, oldField, key));
+        }
+        if (hasNew) {
+          out->Put(entryKey(name, newField, key), key);
+        }
+      }
+      pending[key] = value;
+    }
+
+    if (value) {
+      out->Put(key, *value);
+    } else {
+      out->Delete(key);
+    }
+  }
+  return leveldb::Status::OK();
+}
+
+template <typename WriteFn>
+bool IndexedDB::WriteUnindexed(WriteFn write, leveldb::Status* status) {
+  // CreateIndex sets hasIndexes_ before it waits for unindexedWrites_ to drop to 0, so a write that sees it unset
+  // here finishes before any index is built.
+  ++unindexedWrites_;
+  bool unindexed = !hasIndexes_;
+  if (unindexed) {
+    *status = write();
+  }
+  --unindexedWrites_;
+  return unindexed;
+}
+
+leveldb::Status IndexedDB::Put(const leveldb::WriteOptions& options, const leveldb::Slice& key,
+                               const leveldb::Slice& value) {
+  if (startsWith(key, kReservedPrefix)) {
+    return leveldb::Status::InvalidArgument("reserved key", key);
+  }
+  leveldb::Status status;
+  if (WriteUnindexed([&] { return db_->Put(options, key, value); }, &status)) {
+    return status;
+  }
+  leveldb::WriteBatch batch;
+  batch.Put(key, value);
+  return Write(options, &batch);
+}
+
+leveldb::Status IndexedDB::Delete(const leveldb::WriteOptions& options, const leveldb::Slice& key) {
+  if (startsWith(key, kReservedPrefix)) {
+    return leveldb::Status::InvalidArgument("reserved key", key);
+  }
+  leveldb::Status status;
+  if (WriteUnindexed([&] { return db_->Delete(options, key); }, &status)) {
+    return status;
+  }
+  leveldb::WriteBatch batch;
+  batch.Delete(key);
+  return Write(options, &batch);
+}
+
+leveldb::Status IndexedDB::Write(const leveldb::WriteOptions& options, leveldb::WriteBatch* updates) {
+  // Finds the first reserved key in a batch. This is one pass over the batch's buffer, without copying it.
+  class ReservedKeyFinder : public leveldb::WriteBatch::Handler {
+   public:
+    void Put(const leveldb::Slice& key, const leveldb::Slice& value) override {
+      Check(key);
+    }
+    void Delete(const leveldb::Slice& key) override {
+      Check(key);
+    }
+    void Check(const leveldb::Slice& key) {
+      if (!found && startsWith(key, kReservedPrefix)) {
+        found = key.ToString();
+      }
+    }
+    std::optional<std::string> found;
+  };
+
+  ReservedKeyFinder finder;
+  leveldb::Status status = updates->Iterate(&finder);
+  if (!status.ok()) {
+    return status;
+  }
+  if (finder.found) {
+    return leveldb::Status::InvalidArgument("reserved key", *finder.found);
+  }
+  if (WriteUnindexed([&] { return db_->Write(options, updates); }, &status)) {
+    return status;
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  leveldb::WriteBatch out;
+  status = AddIndexedUpdates(updates, &out);
+  if (!status.ok()) {
+    return status;
+  }
+  return db_->Write(options, &out);
+}
+
+leveldb::Status IndexedDB::Get(const leveldb::ReadOptions& options, const leveldb::Slice& key, std::string* value) {
+  if (startsWith(key, kReservedPrefix)) {
+    return leveldb::Status::NotFound(key);
+  }
+  return db_->Get(options, key, value);
+}
+
+leveldb::Iterator* IndexedDB::NewIterator(const leveldb::ReadOptions& options) {
+  return new UserKeyIterator(db_->NewIterator(options));
+}
+
+const leveldb::Snapshot* IndexedDB::GetSnapshot() {
+  return db_->GetSnapshot();
+}
+
+void IndexedDB::ReleaseSnapshot(const leveldb::Snapshot* snapshot) {
+  db_->ReleaseSnapshot(snapshot);
+}
+
+bool IndexedDB::GetProperty(const leveldb::Slice& property, std::string* value) {
+  return db_->GetProperty(property, value);
+}
+
+void IndexedDB::GetApproximateSizes(const leveldb::Range* range, int n, uint64_t* sizes) {
+  db_->GetApproximateSizes(range, n, sizes);
+  // Subtracts the size of the reserved keys within each range.
+  for (int i = 0; i < n; ++i) {
+    leveldb::Slice start = range[i].start.compare(kReservedPrefix) > 0 ? range[i].start : kReservedPrefix;
+    leveldb::Slice limit = range[i].limit.compare(kReservedEnd) < 0 ? range[i].limit : kReservedEnd;
+    if (start.compare(limit) < 0) {
+      leveldb::Range reserved(start, limit);
+      uint64_t reservedSize;
+      db_->GetApproximateSizes(&reserved, 1, &reservedSize);
+      sizes[i] -= std::min(sizes[i], reservedSize);
+    }
+  }
+}
+
+void IndexedDB::CompactRange(const leveldb::Slice* begin, const leveldb::Slice* end) {
+  db_->CompactRange(begin, end);
+}
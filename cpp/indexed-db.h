@@ -0,0 +1,107 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+#include <leveldb/db.h>
+
+// How an index derives its field from a stored value.
+struct IndexDef {
+  enum Type { kJson, kBytes };
+  Type type = kJson;
+  std::vector<std::string> jsonPath;  // kJson: object keys (or array indexes) leading to a scalar.
+  uint32_t byteOffset = 0;  // kBytes: the field is value[byteOffset, byteOffset + byteLength).
+  uint32_t byteLength = 0;
+
+  // Parses a path like "user.address.city" or "tags.0".
+  static IndexDef Json(const std::string& path);
+  static IndexDef Bytes(uint32_t offset, uint32_t length);
+
+  std::string Serialize() const;
+  static bool Parse(const leveldb::Slice& serialized, IndexDef* def);
+  bool operator==(const IndexDef& other) const;
+};
+
+// Bounds of an index scan, as encoded fields (see IndexedDB::EncodeString etc.). Unset bounds are open.
+struct IndexQuery {
+  std::optional<std::string> gt, gte, lt, lte;
+};
+
+// A leveldb::DB that maintains secondary indexes over the values of another DB, which it owns.
+//
+// Index definitions and entries are stored in the same DB, under keys starting with "\xff\xffidx:". These keys are
+// hidden from Get, iterators and GetApproximateSizes, and every write path rejects them. While there are no indexes,
+// writes are passed through after that check, without locking or copying.
+//
+// While any index is defined, every write reads the old values of the keys it changes, and adds the index entries
+// to remove and to add to the same WriteBatch, so the indexes are updated atomically with the records. These writes
+// are serialized.
+//
+// Index fields are encoded so that they sort by type (null < false < true < numbers < strings/bytes) and then by
+// value; numbers sort numerically. Values without the field (or not parseable as JSON, or too short for a byte
+// range) are not indexed.
+class IndexedDB : public leveldb::DB {
+ public:
+  // Wraps `db`, loading the index definitions stored in it. Takes ownership of `db`, even on error. `indexable`
+  // must only be set if writes to `db` are atomic; otherwise, CreateIndex fails.
+  static leveldb::Status Open(leveldb::DB* db, bool indexable, IndexedDB** dbptr);
+
+  // Defines an index and indexes all existing records. Re-defining an index the same way is a no-op; defining it
+  // differently drops and rebuilds it. Writes wait until the index is complete.
+  leveldb::Status CreateIndex(const std::string& name, const IndexDef& def);
+  leveldb::Status DropIndex(const std::string& name);
+
+  // Returns up to `limit` (0 = all) records whose `index` field lies within `query`, ordered by that field, and then
+  // by key. Records and index are read from the same snapshot.
+  leveldb::Status Scan(const std::string& index, const IndexQuery& query, int limit,
+                       std::vector<std::pair<std::string, std::string>>* records);
+
+  static std::string EncodeNull();
+  static std::string EncodeBool(bool value);
+  static std::string EncodeNumber(double value);
+  static std::string EncodeString(const leveldb::Slice& value);
+
+  // Returns true if `key` lies in the range reserved for index definitions and entries.
+  static bool IsReservedKey(const leveldb::Slice& key);
+
+  leveldb::Status Put(const leveldb::WriteOptions& options, const leveldb::Slice& key,
+                      const leveldb::Slice& value) override;
+  leveldb::Status Delete(const leveldb::WriteOptions& options, const leveldb::Slice& key) override;
+  leveldb::Status Write(const leveldb::WriteOptions& options, leveldb::WriteBatch* updates) override;
+  leveldb::Status Get(const leveldb::ReadOptions& options, const leveldb::Slice& key, std::string* value) override;
+  leveldb::Iterator* NewIterator(const leveldb::ReadOptions& options) override;
+  const leveldb::Snapshot* GetSnapshot() override;
+  void ReleaseSnapshot(const leveldb::Snapshot* snapshot) override;
+  bool GetProperty(const leveldb::Slice& property, std::string* value) override;
+  void GetApproximateSizes(const leveldb::Range* range, int n, uint64_t* sizes) override;
+  void CompactRange(const leveldb::Slice* begin, const leveldb::Slice* end) override;
+
+ private:
+  IndexedDB(leveldb::DB* db, bool indexable) : db_(db), indexable_(indexable) {}
+
+  // Runs `write` directly on db_ and returns true if there are no indexes; returns false otherwise.
+  template <typename WriteFn>
+  bool WriteUnindexed(WriteFn write, leveldb::Status* status);
+
+  // Adds the changes to write `updates` (including index entries) to `out`. REQUIRES: mutex_ held, and no reserved
+  // keys in `updates`.
+  leveldb::Status AddIndexedUpdates(leveldb::WriteBatch* updates, leveldb::WriteBatch* out);
+  // REQUIRES: mutex_ held, and no writes on the unindexed path.
+  leveldb::Status BuildIndex(const std::string& name, const IndexDef& def);
+  leveldb::Status ClearIndexEntries(const std::string& name);
+
+  std::unique_ptr<leveldb::DB> db_;
+  const bool indexable_;
+  std::mutex mutex_;
+  std::map<std::string, IndexDef> indexes_;  // Guarded by mutex_.
+  // Set while indexes_ is not empty, and while an index is being built. Writes that see it unset skip mutex_, and
+  // count themselves in unindexedWrites_ until they are done.
+  std::atomic<bool> hasIndexes_{false};
+  std::atomic<int> unindexedWrites_{0};
+};
@@ -3,13 +3,23 @@
 #include <iostream>
 #include <fstream>
 #include <sstream>
+#include <chrono>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <future>
+#include <unordered_map>
 #import <leveldb/db.h>
 #import <leveldb/write_batch.h>
+#import "sharded-db.h"
+#import "db-dump.h"
+#import "indexed-db.h"
 
 using namespace facebook;
 
 
 // TODO(savv): consider re-using unique_ptrs, if they are empty.
+// Every DB in here is an IndexedDB (see openDb).
 std::vector<std::unique_ptr<leveldb::DB>> dbs;
 std::vector<std::unique_ptr<leveldb::Iterator>> iterators;
 
@@ -33,6 +43,211 @@ bool valueToString(jsi::Runtime& runtime, const jsi::Value& value, std::string*
   return false;
 }
 
+// A half-open key range [start, end). An empty `end` with hasEnd=false means "until the last key".
+struct KeyRange {
+  std::string start;
+  std::string end;
+  bool hasEnd = false;
+
+  bool contains(const leveldb::Slice& key) const {
+    return !hasEnd || key.compare(end) < 0;
+  }
+};
+
+// Parses an optional `{start?, end?}` or `{prefix}` object. Returns false if the object is malformed.
+bool valueToRange(jsi::Runtime& runtime, const jsi::Value& value, KeyRange* range) {
+  *range = KeyRange();
+  if (value.isUndefined() || value.isNull()) {
+    return true;
+  }
+  if (!value.isObject()) {
+    return false;
+  }
+
+  auto obj = value.getObject(runtime);
+  auto start = obj.getProperty(runtime, "start");
+  auto end = obj.getProperty(runtime, "end");
+  auto prefix = obj.getProperty(runtime, "prefix");
+  if (!prefix.isUndefined()) {
+    if (!start.isUndefined() || !end.isUndefined() || !valueToString(runtime, prefix, &range->start)) {
+      return false;
+    }
+    // The end of a prefix range is the shortest key greater than all keys starting with it; there is none if the
+    // prefix consists of 0xff bytes only.
+    range->end = range->start;
+    while (!range->end.empty() && (unsigned char)range->end.back() == 0xff) {
+      range->end.pop_back();
+    }
+    range->hasEnd = !range->end.empty();
+    if (range->hasEnd) {
+      range->end.back()++;
+    }
+    return true;
+  }
+
+  if (!start.isUndefined() && !valueToString(runtime, start, &range->start)) {
+    return false;
+  }
+  if (!end.isUndefined()) {
+    if (!valueToString(runtime, end, &range->end)) {
+      return false;
+    }
+    range->hasEnd = true;
+  }
+  return true;
+}
+
+// Everything needed to open a DB, parsed from JS arguments so that it can be handed over to another thread.
+struct OpenRequest {
+  std::string path;
+  leveldb::Options options;
+  int numShards = 0;
+  std::string prefixDelimiter;
+  std::vector<KeyRange> prewarm;
+};
+
+struct OpenStats {
+  bool ready = false;
+  std::string error;
+  double openMs = 0;  // Time spent in DB::Open, which is mostly replaying the log after an unclean shutdown.
+  double prewarmMs = 0;
+  double prewarmBytes = 0;
+  double blockedMs = 0;  // Time the JS thread waited for a leveldbOpenAsync to finish.
+};
+
+struct OpenResult {
+  leveldb::DB* db;
+  OpenStats stats;
+};
+
+// DBs opened with leveldbOpenAsync, keyed by their index in `dbs`. They are moved into `dbs` once used or polled.
+std::unordered_map<int, std::future<OpenResult>> pendingOpens;
+std::unordered_map<int, OpenStats> openStats;
+
+// Prewarming stops after reading this many bytes: that's the size of LevelDB's default block cache, so reading more
+// would only evict the blocks loaded first.
+const double kPrewarmMaxBytes = 8 << 20;
+
+// An export or import, running on its own thread.
+struct DumpJob {
+  int dbIdx;
+  std::future<leveldb::Status> result;
+  DumpProgress progress;
+};
+
+std::vector<std::unique_ptr<DumpJob>> dumpJobs;
+
+// Blocks until all exports and imports of the given DB (or of all DBs, for -1) are done, so that it can be closed.
+void waitForDumpJobs(int dbIdx) {
+  for (auto& job : dumpJobs) {
+    if (job && (dbIdx == -1 || job->dbIdx == dbIdx)) {
+      job->result.wait();
+    }
+  }
+}
+
+double millisSince(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Parses the arguments shared by leveldbOpen and leveldbOpenAsync: db path, create_if_missing, error_if_exists,
+// optional number of shards, optional shard prefix delimiter, optional array of ranges to prewarm, optional write
+// buffer size.
+bool valueToOpenRequest(jsi::Runtime& runtime, const std::string& documentDir, const jsi::Value* arguments,
+                        size_t count, OpenRequest* request) {
+  if (count < 3 || !arguments[0].isString() || !arguments[1].isBool() || !arguments[2].isBool()) {
+    return false;
+  }
+  request->path = documentDir + arguments[0].getString(runtime).utf8(runtime);
+  request->options.create_if_missing = arguments[1].getBool();
+  request->options.error_if_exists = arguments[2].getBool();
+
+  if (count > 3 && !arguments[3].isUndefined()) {
+    if (!arguments[3].isNumber() || arguments[3].getNumber() < 1) {
+      return false;
+    }
+    request->numShards = (int)arguments[3].getNumber();
+  }
+  if (count > 4 && !arguments[4].isUndefined() && !valueToString(runtime, arguments[4], &request->prefixDelimiter)) {
+    return false;
+  }
+  if (count > 5 && !arguments[5].isUndefined()) {
+    if (!arguments[5].isObject() || !arguments[5].getObject(runtime).isArray(runtime)) {
+      return false;
+    }
+    auto ranges = arguments[5].getObject(runtime).getArray(runtime);
+    for (size_t i = 0; i < ranges.size(runtime); ++i) {
+      request->prewarm.emplace_back();
+      if (!valueToRange(runtime, ranges.getValueAtIndex(runtime, i), &request->prewarm.back())) {
+        return false;
+      }
+    }
+  }
+  if (count > 6 && !arguments[6].isUndefined()) {
+    if (!arguments[6].isNumber() || arguments[6].getNumber() < 1) {
+      return false;
+    }
+    request->options.write_buffer_size = (size_t)arguments[6].getNumber();
+  }
+  return true;
+}
+
+// Opens a DB, wraps it into an IndexedDB and prewarms its block cache. Runs on the JS thread for leveldbOpen, and on
+// its own thread for leveldbOpenAsync. Returns a null db on error.
+OpenResult openDb(const OpenRequest& request) {
+  OpenResult result{nullptr, OpenStats()};
+  auto start = std::chrono::steady_clock::now();
+  // Paths that already hold a sharded DB are opened as such, even if no number of shards was passed.
+  bool sharded = request.numShards > 0 || ShardedDB::Exists(request.path);
+  leveldb::Status status = sharded
+      ? ShardedDB::Open(request.options, request.path, request.numShards, request.prefixDelimiter, &result.db)
+      : leveldb::DB::Open(request.options, request.path, &result.db);
+  if (status.ok()) {
+    // Writes to a sharded DB are not atomic across shards, so records and their index entries could diverge.
+    IndexedDB* indexed = nullptr;
+    status = IndexedDB::Open(result.db, !sharded, &indexed);
+    result.db = status.ok() ? indexed : nullptr;  // IndexedDB::Open deletes the DB on error.
+  }
+  result.stats.openMs = millisSince(start);
+  result.stats.ready = true;
+  if (!status.ok()) {
+    result.db = nullptr;
+    result.stats.error = status.ToString();
+    return result;
+  }
+
+  // Reading the ranges through an iterator loads their blocks into the block cache.
+  start = std::chrono::steady_clock::now();
+  for (auto& range : request.prewarm) {
+    std::unique_ptr<leveldb::Iterator> it(result.db->NewIterator(leveldb::ReadOptions()));
+    for (it->Seek(range.start); it->Valid() && range.contains(it->key()) && result.stats.prewarmBytes < kPrewarmMaxBytes;
+         it->Next()) {
+      result.stats.prewarmBytes += it->key().size() + it->value().size();
+    }
+  }
+  result.stats.prewarmMs = millisSince(start);
+  return result;
+}
+
+// Moves the result of a finished leveldbOpenAsync into `dbs`. With `wait`, blocks until the open is done; otherwise
+// returns right away if it is still running.
+void resolvePendingOpen(int idx, bool wait) {
+  auto pending = pendingOpens.find(idx);
+  if (pending == pendingOpens.end()) {
+    return;
+  }
+  if (!wait && pending->second.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+    return;
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  OpenResult result = pending->second.get();
+  result.stats.blockedMs = wait ? millisSince(start) : 0;
+  pendingOpens.erase(pending);
+  dbs[idx].reset(result.db);
+  openStats[idx] = result.stats;
+}
+
 leveldb::DB* valueToDb(const jsi::Value& value, std::string* err) {
   if (!value.isNumber()) {
     *err = "valueToDb/param-not-a-number";
@@ -43,14 +258,81 @@ leveldb::DB* valueToDb(const jsi::Value& value, std::string* err) {
     *err = "valueToDb/idx-out-of-range";
     return nullptr;
   }
+  resolvePendingOpen(idx, true);
   if (!dbs[idx].get()) {
-    *err = "valueToDb/db-closed";
+    auto stats = openStats.find(idx);
+    *err = stats != openStats.end() && !stats->second.error.empty()
+        ? "valueToDb/open-failed/" + stats->second.error
+        : "valueToDb/db-closed";
     return nullptr;
   }
 
   return dbs[idx].get();
 }
 
+IndexedDB* valueToIndexedDb(const jsi::Value& value, std::string* err) {
+  return static_cast<IndexedDB*>(valueToDb(value, err));
+}
+
+// Encodes a value to compare index fields with. Returns false if the value is not null, a boolean, a finite number,
+// a string or an ArrayBuffer.
+bool valueToIndexField(jsi::Runtime& runtime, const jsi::Value& value, std::string* field) {
+  std::string str;
+  if (value.isNull()) {
+    *field = IndexedDB::EncodeNull();
+  } else if (value.isBool()) {
+    *field = IndexedDB::EncodeBool(value.getBool());
+  } else if (value.isNumber() && std::isfinite(value.getNumber())) {
+    *field = IndexedDB::EncodeNumber(value.getNumber());
+  } else if (valueToString(runtime, value, &str)) {
+    *field = IndexedDB::EncodeString(str);
+  } else {
+    return false;
+  }
+  return true;
+}
+
+// Parses an optional {equals?, gt?, gte?, lt?, lte?} object into an IndexQuery.
+bool valueToIndexQuery(jsi::Runtime& runtime, const jsi::Value& value, IndexQuery* query) {
+  *query = IndexQuery();
+  if (value.isUndefined() || value.isNull()) {
+    return true;
+  }
+  if (!value.isObject()) {
+    return false;
+  }
+  auto obj = value.getObject(runtime);
+  std::pair<const char*, std::optional<std::string>*> bounds[] = {
+      {"gt", &query->gt}, {"gte", &query->gte}, {"lt", &query->lt}, {"lte", &query->lte}};
+  for (auto& [name, bound] : bounds) {
+    auto prop = obj.getProperty(runtime, name);
+    if (!prop.isUndefined()) {
+      std::string field;
+      if (!valueToIndexField(runtime, prop, &field)) {
+        return false;
+      }
+      *bound = field;
+    }
+  }
+  auto equals = obj.getProperty(runtime, "equals");
+  if (!equals.isUndefined()) {
+    std::string field;
+    if (!valueToIndexField(runtime, equals, &field)) {
+      return false;
+    }
+    query->gte = query->lte = field;
+  }
+  return true;
+}
+
+jsi::Object stringToArrayBuffer(jsi::Runtime& runtime, const std::string& str) {
+  jsi::Function arrayBufferCtor = runtime.global().getPropertyAsFunction(runtime, "ArrayBuffer");
+  jsi::Object o = arrayBufferCtor.callAsConstructor(runtime, (int)str.length()).getObject(runtime);
+  jsi::ArrayBuffer buf = o.getArrayBuffer(runtime);
+  memcpy(buf.data(runtime), str.c_str(), str.size());
+  return o;
+}
+
 leveldb::Iterator* valueToIterator(const jsi::Value& value) {
   if (!value.isNumber()) {
     return nullptr;
@@ -72,31 +354,84 @@ void installLeveldb(jsi::Runtime& jsiRuntime, std::string documentDir) {
   auto leveldbOpen = jsi::Function::createFromHostFunction(
       jsiRuntime,
       jsi::PropNameID::forAscii(jsiRuntime, "leveldbOpen"),
-      3,  // db path, create_if_missing, error_if_exists
+      7,  // db path, create_if_missing, error_if_exists, optional number of shards, optional shard prefix delimiter,
+          // optional ranges to prewarm, optional write buffer size
       [documentDir](jsi::Runtime& runtime, const jsi::Value& thisValue, const jsi::Value* arguments, size_t count) -> jsi::Value {
-        if (!arguments[0].isString() || !arguments[1].isBool() || !arguments[2].isBool()) {
+        OpenRequest request;
+        if (!valueToOpenRequest(runtime, documentDir, arguments, count, &request)) {
           throw jsi::JSError(runtime, "leveldbOpen/invalid-params");
         }
 
-        leveldb::Options options;
-        std::string path = documentDir + arguments[0].getString(runtime).utf8(runtime);
-        options.create_if_missing = arguments[1].getBool();
-        options.error_if_exists = arguments[2].getBool();
-        leveldb::DB* db;
-        leveldb::Status status = leveldb::DB::Open(options, path, &db);
-        dbs.push_back(std::unique_ptr<leveldb::DB>{db});
+        OpenResult result = openDb(request);
+        dbs.push_back(std::unique_ptr<leveldb::DB>{result.db});
         int idx = (int)dbs.size() - 1;
 
-        if (!status.ok()) {
-          dbs[idx].reset();
-          throw jsi::JSError(runtime, "leveldbOpen/" + status.ToString());
+        if (!result.db) {
+          throw jsi::JSError(runtime, "leveldbOpen/" + result.stats.error);
         }
+        openStats[idx] = result.stats;
 
         return jsi::Value(idx);
       }
   );
   jsiRuntime.global().setProperty(jsiRuntime, "leveldbOpen", std::move(leveldbOpen));
 
+  auto leveldbOpenAsync = jsi::Function::createFromHostFunction(
+      jsiRuntime,
+      jsi::PropNameID::forAscii(jsiRuntime, "leveldbOpenAsync"),
+      7,  // same as leveldbOpen
+      [documentDir](jsi::Runtime& runtime, const jsi::Value& thisValue, const jsi::Value* arguments, size_t count) -> jsi::Value {
+        OpenRequest request;
+        if (!valueToOpenRequest(runtime, documentDir, arguments, count, &request)) {
+          throw jsi::JSError(runtime, "leveldbOpenAsync/invalid-params");
+        }
+
+        // The index is handed out right away; calls using it block until the open is done (see valueToDb).
+        dbs.push_back(nullptr);
+        int idx = (int)dbs.size() - 1;
+        pendingOpens[idx] = std::async(std::launch::async, openDb, std::move(request));
+        return jsi::Value(idx);
+      }
+  );
+  jsiRuntime.global().setProperty(jsiRuntime, "leveldbOpenAsync", std::move(leveldbOpenAsync));
+
+  auto leveldbOpenStats = jsi::Function::createFromHostFunction(
+      jsiRuntime,
+      jsi::PropNameID::forAscii(jsiRuntime, "leveldbOpenStats"),
+      1,  // dbs index
+      [](jsi::Runtime& runtime, const jsi::Value& thisValue, const jsi::Value* arguments, size_t count) -> jsi::Value {
+        if (!arguments[0].isNumber()) {
+          throw jsi::JSError(runtime, "leveldbOpenStats/invalid-params");
+        }
+        int idx = (int)arguments[0].getNumber();
+        if (idx < 0 || idx >= dbs.size()) {
+          throw jsi::JSError(runtime, "leveldbOpenStats/db-idx-out-of-bounds");
+        }
+
+        // Never blocks: while leveldbOpenAsync is running, this returns {ready: false}.
+        resolvePendingOpen(idx, false);
+        OpenStats stats;
+        auto found = openStats.find(idx);
+        if (found != openStats.end()) {
+          stats = found->second;
+        } else if (!pendingOpens.count(idx)) {
+          throw jsi::JSError(runtime, "leveldbOpenStats/db-closed");
+        }
+
+        jsi::Object o(runtime);
+        o.setProperty(runtime, "ready", stats.ready);
+        if (!stats.error.empty()) {
+          o.setProperty(runtime, "error", jsi::String::createFromUtf8(runtime, stats.error));
+        }
+        o.setProperty(runtime, "openMs", stats.openMs);
+        o.setProperty(runtime, "prewarmMs", stats.prewarmMs);
+        o.setProperty(runtime, "prewarmBytes", stats.prewarmBytes);
+        o.setProperty(runtime, "blockedMs", stats.blockedMs);
+        return o;
+      }
+  );
+  jsiRuntime.global().setProperty(jsiRuntime, "leveldbOpenStats", std::move(leveldbOpenStats));
+
   auto leveldbDestroy = jsi::Function::createFromHostFunction(
       jsiRuntime,
       jsi::PropNameID::forAscii(jsiRuntime, "leveldbDestroy"),
@@ -108,7 +443,9 @@ void installLeveldb(jsi::Runtime& jsiRuntime, std::string documentDir) {
 
         leveldb::Options options;
         std::string path = documentDir + arguments[0].getString(runtime).utf8(runtime);
-        leveldb::Status status = leveldb::DestroyDB(path, options);
+        leveldb::Status status = ShardedDB::Exists(path)
+            ? ShardedDB::Destroy(path, options)
+            : leveldb::DestroyDB(path, options);
         if (!status.ok()) {
           throw jsi::JSError(runtime, "leveldbDestroy/" + status.ToString());
         }
@@ -127,11 +464,19 @@ void installLeveldb(jsi::Runtime& jsiRuntime, std::string documentDir) {
           throw jsi::JSError(runtime, "leveldbClose/invalid-params");
         }
         int idx = (int)arguments[0].getNumber();
+        if (idx >= 0 && idx < dbs.size()) {
+          resolvePendingOpen(idx, true);
+          if (!dbs[idx].get() && openStats.erase(idx)) {
+            return nullptr;  // A leveldbOpenAsync that failed.
+          }
+        }
         if (idx < 0 || idx >= dbs.size() || !dbs[idx].get()) {
           throw jsi::JSError(runtime, "leveldbClose/db-idx-out-of-bounds");
         }
 
+        waitForDumpJobs(idx);
         dbs[idx].reset();
+        openStats.erase(idx);
         return nullptr;
       }
   );
@@ -514,6 +859,319 @@ void installLeveldb(jsi::Runtime& jsiRuntime, std::string documentDir) {
   );
   jsiRuntime.global().setProperty(jsiRuntime, "leveldbMerge", std::move(leveldbMerge));
 
+  auto leveldbClearRange = jsi::Function::createFromHostFunction(
+      jsiRuntime,
+      jsi::PropNameID::forAscii(jsiRuntime, "leveldbClearRange"),
+      3,  // dbs index, range, batch size
+      [](jsi::Runtime& runtime, const jsi::Value& thisValue, const jsi::Value* arguments, size_t count) -> jsi::Value {
+        std::string dbErr;
+        leveldb::DB* db = valueToDb(arguments[0], &dbErr);
+        if (!db) {
+          throw jsi::JSError(runtime, "leveldbClearRange/" + dbErr);
+        }
+        KeyRange range;
+        if (!valueToRange(runtime, arguments[1], &range) || !arguments[2].isNumber() || arguments[2].getNumber() < 1) {
+          throw jsi::JSError(runtime, "leveldbClearRange/invalid-params");
+        }
+        int batchSize = (int)arguments[2].getNumber();
+
+        // Deletes are flushed every `batchSize` keys, so that clearing a large range doesn't build one huge batch.
+        leveldb::ReadOptions readOptions;
+        readOptions.fill_cache = false;
+        std::unique_ptr<leveldb::Iterator> it(db->NewIterator(readOptions));
+        leveldb::WriteBatch batch;
+        int batchCount = 0;
+        double deleted = 0;
+        for (it->Seek(range.start); it->Valid() && range.contains(it->key()); it->Next()) {
+          batch.Delete(it->key());
+          ++deleted;
+          if (++batchCount == batchSize) {
+            auto status = db->Write(leveldb::WriteOptions(), &batch);
+            if (!status.ok()) {
+              throw jsi::JSError(runtime, "leveldbClearRange/" + status.ToString());
+            }
+            batch.Clear();
+            batchCount = 0;
+          }
+        }
+
+        if (!it->status().ok()) {
+          throw jsi::JSError(runtime, "leveldbClearRange/" + it->status().ToString());
+        }
+        if (batchCount) {
+          auto status = db->Write(leveldb::WriteOptions(), &batch);
+          if (!status.ok()) {
+            throw jsi::JSError(runtime, "leveldbClearRange/" + status.ToString());
+          }
+        }
+
+        return jsi::Value(deleted);
+      }
+  );
+  jsiRuntime.global().setProperty(jsiRuntime, "leveldbClearRange", std::move(leveldbClearRange));
+
+  auto leveldbCountRange = jsi::Function::createFromHostFunction(
+      jsiRuntime,
+      jsi::PropNameID::forAscii(jsiRuntime, "leveldbCountRange"),
+      3,  // dbs index, range, limit (0 for no limit)
+      [](jsi::Runtime& runtime, const jsi::Value& thisValue, const jsi::Value* arguments, size_t count) -> jsi::Value {
+        std::string dbErr;
+        leveldb::DB* db = valueToDb(arguments[0], &dbErr);
+        if (!db) {
+          throw jsi::JSError(runtime, "leveldbCountRange/" + dbErr);
+        }
+        KeyRange range;
+        if (!valueToRange(runtime, arguments[1], &range) || !arguments[2].isNumber()) {
+          throw jsi::JSError(runtime, "leveldbCountRange/invalid-params");
+        }
+        double limit = arguments[2].getNumber();
+
+        // Only keys are compared here; values are never copied out of the blocks.
+        leveldb::ReadOptions readOptions;
+        readOptions.fill_cache = false;
+        std::unique_ptr<leveldb::Iterator> it(db->NewIterator(readOptions));
+        double found = 0;
+        for (it->Seek(range.start); it->Valid() && range.contains(it->key()) && (limit <= 0 || found < limit); it->Next()) {
+          ++found;
+        }
+
+        if (!it->status().ok()) {
+          throw jsi::JSError(runtime, "leveldbCountRange/" + it->status().ToString());
+        }
+
+        return jsi::Value(found);
+      }
+  );
+  jsiRuntime.global().setProperty(jsiRuntime, "leveldbCountRange", std::move(leveldbCountRange));
+
+  auto leveldbApproximateSize = jsi::Function::createFromHostFunction(
+      jsiRuntime,
+      jsi::PropNameID::forAscii(jsiRuntime, "leveldbApproximateSize"),
+      2,  // dbs index, range
+      [](jsi::Runtime& runtime, const jsi::Value& thisValue, const jsi::Value* arguments, size_t count) -> jsi::Value {
+        std::string dbErr;
+        leveldb::DB* db = valueToDb(arguments[0], &dbErr);
+        if (!db) {
+          throw jsi::JSError(runtime, "leveldbApproximateSize/" + dbErr);
+        }
+        KeyRange range;
+        if (!valueToRange(runtime, arguments[1], &range)) {
+          throw jsi::JSError(runtime, "leveldbApproximateSize/invalid-params");
+        }
+
+        // GetApproximateSizes needs a limit key; for open-ended ranges, use the key just past the last one.
+        if (!range.hasEnd) {
+          std::unique_ptr<leveldb::Iterator> it(db->NewIterator(leveldb::ReadOptions()));
+          it->SeekToLast();
+          if (!it->Valid()) {
+            return jsi::Value(0);
+          }
+          range.end = it->key().ToString() + '\0';
+        }
+        if (leveldb::Slice(range.start).compare(range.end) >= 0) {
+          return jsi::Value(0);
+        }
+
+        leveldb::Range ldbRange(range.start, range.end);
+        uint64_t size = 0;
+        db->GetApproximateSizes(&ldbRange, 1, &size);
+        return jsi::Value((double)size);
+      }
+  );
+  jsiRuntime.global().setProperty(jsiRuntime, "leveldbApproximateSize", std::move(leveldbApproximateSize));
+
+  auto leveldbExport = jsi::Function::createFromHostFunction(
+      jsiRuntime,
+      jsi::PropNameID::forAscii(jsiRuntime, "leveldbExport"),
+      3,  // dbs index, dump path (relative to the document dir, unless absolute), compress
+      [documentDir](jsi::Runtime& runtime, const jsi::Value& thisValue, const jsi::Value* arguments, size_t count) -> jsi::Value {
+        std::string dbErr;
+        leveldb::DB* db = valueToDb(arguments[0], &dbErr);
+        if (!db) {
+          throw jsi::JSError(runtime, "leveldbExport/" + dbErr);
+        }
+        std::string path;
+        if (!valueToString(runtime, arguments[1], &path) || path.empty() || !arguments[2].isBool()) {
+          throw jsi::JSError(runtime, "leveldbExport/invalid-params");
+        }
+        if (path[0] != '/') {
+          path = documentDir + path;
+        }
+        bool compress = arguments[2].getBool();
+
+        dumpJobs.push_back(std::make_unique<DumpJob>());
+        DumpJob* job = dumpJobs.back().get();
+        job->dbIdx = (int)arguments[0].getNumber();
+        job->result = std::async(std::launch::async, [db, path, compress, job]() {
+          return ExportDump(db, path, compress, &job->progress);
+        });
+        return jsi::Value((int)dumpJobs.size() - 1);
+      }
+  );
+  jsiRuntime.global().setProperty(jsiRuntime, "leveldbExport", std::move(leveldbExport));
+
+  auto leveldbImport = jsi::Function::createFromHostFunction(
+      jsiRuntime,
+      jsi::PropNameID::forAscii(jsiRuntime, "leveldbImport"),
+      2,  // dbs index, dump path (relative to the document dir, unless absolute)
+      [documentDir](jsi::Runtime& runtime, const jsi::Value& thisValue, const jsi::Value* arguments, size_t count) -> jsi::Value {
+        std::string dbErr;
+        leveldb::DB* db = valueToDb(arguments[0], &dbErr);
+        if (!db) {
+          throw jsi::JSError(runtime, "leveldbImport/" + dbErr);
+        }
+        std::string path;
+        if (!valueToString(runtime, arguments[1], &path) || path.empty()) {
+          throw jsi::JSError(runtime, "leveldbImport/invalid-params");
+        }
+        if (path[0] != '/') {
+          path = documentDir + path;
+        }
+
+        dumpJobs.push_back(std::make_unique<DumpJob>());
+        DumpJob* job = dumpJobs.back().get();
+        job->dbIdx = (int)arguments[0].getNumber();
+        job->result = std::async(std::launch::async, [db, path, job]() {
+          return ImportDump(db, path, &job->progress);
+        });
+        return jsi::Value((int)dumpJobs.size() - 1);
+      }
+  );
+  jsiRuntime.global().setProperty(jsiRuntime, "leveldbImport", std::move(leveldbImport));
+
+  auto leveldbDumpJobStatus = jsi::Function::createFromHostFunction(
+      jsiRuntime,
+      jsi::PropNameID::forAscii(jsiRuntime, "leveldbDumpJobStatus"),
+      1,  // dumpJobs index
+      [](jsi::Runtime& runtime, const jsi::Value& thisValue, const jsi::Value* arguments, size_t count) -> jsi::Value {
+        if (!arguments[0].isNumber()) {
+          throw jsi::JSError(runtime, "leveldbDumpJobStatus/invalid-params");
+        }
+        int idx = (int)arguments[0].getNumber();
+        if (idx < 0 || idx >= dumpJobs.size() || !dumpJobs[idx].get()) {
+          throw jsi::JSError(runtime, "leveldbDumpJobStatus/job-idx-out-of-bounds");
+        }
+
+        // Never blocks. Once a job is reported as done, it is deleted.
+        DumpJob* job = dumpJobs[idx].get();
+        bool done = job->result.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+        jsi::Object o(runtime);
+        o.setProperty(runtime, "done", done);
+        o.setProperty(runtime, "entries", (double)job->progress.entries);
+        o.setProperty(runtime, "bytes", (double)job->progress.bytes);
+        if (done) {
+          leveldb::Status status = job->result.get();
+          if (!status.ok()) {
+            o.setProperty(runtime, "error", jsi::String::createFromUtf8(runtime, status.ToString()));
+          }
+          dumpJobs[idx].reset();
+        }
+        return o;
+      }
+  );
+  jsiRuntime.global().setProperty(jsiRuntime, "leveldbDumpJobStatus", std::move(leveldbDumpJobStatus));
+
+  auto leveldbCreateIndex = jsi::Function::createFromHostFunction(
+      jsiRuntime,
+      jsi::PropNameID::forAscii(jsiRuntime, "leveldbCreateIndex"),
+      3,  // dbs index, index name, {jsonPath} or {byteOffset, byteLength}
+      [](jsi::Runtime& runtime, const jsi::Value& thisValue, const jsi::Value* arguments, size_t count) -> jsi::Value {
+        std::string dbErr;
+        IndexedDB* db = valueToIndexedDb(arguments[0], &dbErr);
+        if (!db) {
+          throw jsi::JSError(runtime, "leveldbCreateIndex/" + dbErr);
+        }
+        if (!arguments[1].isString() || !arguments[2].isObject()) {
+          throw jsi::JSError(runtime, "leveldbCreateIndex/invalid-params");
+        }
+        std::string name = arguments[1].getString(runtime).utf8(runtime);
+        auto spec = arguments[2].getObject(runtime);
+        auto jsonPath = spec.getProperty(runtime, "jsonPath");
+        auto byteOffset = spec.getProperty(runtime, "byteOffset");
+        auto byteLength = spec.getProperty(runtime, "byteLength");
+        IndexDef def;
+        if (jsonPath.isString()) {
+          def = IndexDef::Json(jsonPath.getString(runtime).utf8(runtime));
+        } else if (byteOffset.isNumber() && byteLength.isNumber() && byteOffset.getNumber() >= 0 &&
+                   byteLength.getNumber() >= 1) {
+          def = IndexDef::Bytes((uint32_t)byteOffset.getNumber(), (uint32_t)byteLength.getNumber());
+        } else {
+          throw jsi::JSError(runtime, "leveldbCreateIndex/invalid-params");
+        }
+
+        auto status = db->CreateIndex(name, def);
+        if (!status.ok()) {
+          throw jsi::JSError(runtime, "leveldbCreateIndex/" + status.ToString());
+        }
+        return nullptr;
+      }
+  );
+  jsiRuntime.global().setProperty(jsiRuntime, "leveldbCreateIndex", std::move(leveldbCreateIndex));
+
+  auto leveldbDropIndex = jsi::Function::createFromHostFunction(
+      jsiRuntime,
+      jsi::PropNameID::forAscii(jsiRuntime, "leveldbDropIndex"),
+      2,  // dbs index, index name
+      [](jsi::Runtime& runtime, const jsi::Value& thisValue, const jsi::Value* arguments, size_t count) -> jsi::Value {
+        std::string dbErr;
+        IndexedDB* db = valueToIndexedDb(arguments[0], &dbErr);
+        if (!db) {
+          throw jsi::JSError(runtime, "leveldbDropIndex/" + dbErr);
+        }
+        if (!arguments[1].isString()) {
+          throw jsi::JSError(runtime, "leveldbDropIndex/invalid-params");
+        }
+
+        auto status = db->DropIndex(arguments[1].getString(runtime).utf8(runtime));
+        if (!status.ok() && !status.IsNotFound()) {
+          throw jsi::JSError(runtime, "leveldbDropIndex/" + status.ToString());
+        }
+        return nullptr;
+      }
+  );
+  jsiRuntime.global().setProperty(jsiRuntime, "leveldbDropIndex", std::move(leveldbDropIndex));
+
+  auto leveldbIndexScan = jsi::Function::createFromHostFunction(
+      jsiRuntime,
+      jsi::PropNameID::forAscii(jsiRuntime, "leveldbIndexScan"),
+      5,  // dbs index, index name, query, limit (0 for no limit), return ArrayBuffers (instead of strings)
+      [](jsi::Runtime& runtime, const jsi::Value& thisValue, const jsi::Value* arguments, size_t count) -> jsi::Value {
+        std::string dbErr;
+        IndexedDB* db = valueToIndexedDb(arguments[0], &dbErr);
+        if (!db) {
+          throw jsi::JSError(runtime, "leveldbIndexScan/" + dbErr);
+        }
+        IndexQuery query;
+        if (!arguments[1].isString() || !valueToIndexQuery(runtime, arguments[2], &query) || !arguments[3].isNumber() ||
+            !arguments[4].isBool()) {
+          throw jsi::JSError(runtime, "leveldbIndexScan/invalid-params");
+        }
+        bool asBuf = arguments[4].getBool();
+
+        std::vector<std::pair<std::string, std::string>> records;
+        auto status = db->Scan(arguments[1].getString(runtime).utf8(runtime), query, (int)arguments[3].getNumber(),
+                               &records);
+        if (!status.ok()) {
+          throw jsi::JSError(runtime, "leveldbIndexScan/" + status.ToString());
+        }
+
+        jsi::Array result(runtime, records.size());
+        for (size_t i = 0; i < records.size(); ++i) {
+          jsi::Array record(runtime, 2);
+          if (asBuf) {
+            record.setValueAtIndex(runtime, 0, stringToArrayBuffer(runtime, records[i].first));
+            record.setValueAtIndex(runtime, 1, stringToArrayBuffer(runtime, records[i].second));
+          } else {
+            record.setValueAtIndex(runtime, 0, jsi::String::createFromUtf8(runtime, records[i].first));
+            record.setValueAtIndex(runtime, 1, jsi::String::createFromUtf8(runtime, records[i].second));
+          }
+          result.setValueAtIndex(runtime, i, std::move(record));
+        }
+        return result;
+      }
+  );
+  jsiRuntime.global().setProperty(jsiRuntime, "leveldbIndexScan", std::move(leveldbIndexScan));
+
   auto leveldbReadFileBuf = jsi::Function::createFromHostFunction(
       jsiRuntime,
       jsi::PropNameID::forAscii(jsiRuntime, "leveldbReadFileBuf"),
@@ -548,9 +1206,59 @@ void installLeveldb(jsi::Runtime& jsiRuntime, std::string documentDir) {
       }
   );
     jsiRuntime.global().setProperty(jsiRuntime, "leveldbReadFileBuf", std::move(leveldbReadFileBuf));
+
+  auto leveldbWriteFileBuf = jsi::Function::createFromHostFunction(
+      jsiRuntime,
+      jsi::PropNameID::forAscii(jsiRuntime, "leveldbWriteFileBuf"),
+      2,  // path (relative to the document dir, unless absolute), ArrayBuffer
+      [documentDir](jsi::Runtime& runtime, const jsi::Value& thisValue, const jsi::Value* arguments, size_t count) -> jsi::Value {
+        std::string path;
+        if (!valueToString(runtime, arguments[0], &path) || path.empty() || !arguments[1].isObject() ||
+            !arguments[1].getObject(runtime).isArrayBuffer(runtime)) {
+          throw jsi::JSError(runtime, "leveldbWriteFileBuf/invalid-params");
+        }
+        if (path[0] != '/') {
+          path = documentDir + path;
+        }
+        auto buf = arguments[1].getObject(runtime).getArrayBuffer(runtime);
+        std::ofstream file(path, std::ios::out | std::ios::binary | std::ios::trunc);
+        if (!file || !file.write((const char*)buf.data(runtime), buf.size(runtime)) || !file.flush()) {
+          throw jsi::JSError(runtime, "leveldbWriteFileBuf/write-error/" + std::string(std::strerror(errno)));
+        }
+        return nullptr;
+      }
+  );
+  jsiRuntime.global().setProperty(jsiRuntime, "leveldbWriteFileBuf", std::move(leveldbWriteFileBuf));
+
+  auto leveldbDeleteFile = jsi::Function::createFromHostFunction(
+      jsiRuntime,
+      jsi::PropNameID::forAscii(jsiRuntime, "leveldbDeleteFile"),
+      1,  // path (relative to the document dir, unless absolute)
+      [documentDir](jsi::Runtime& runtime, const jsi::Value& thisValue, const jsi::Value* arguments, size_t count) -> jsi::Value {
+        std::string path;
+        if (!valueToString(runtime, arguments[0], &path) || path.empty()) {
+          throw jsi::JSError(runtime, "leveldbDeleteFile/invalid-params");
+        }
+        if (path[0] != '/') {
+          path = documentDir + path;
+        }
+        if (std::remove(path.c_str()) != 0 && errno != ENOENT) {
+          throw jsi::JSError(runtime, "leveldbDeleteFile/" + std::string(std::strerror(errno)));
+        }
+        return nullptr;
+      }
+  );
+  jsiRuntime.global().setProperty(jsiRuntime, "leveldbDeleteFile", std::move(leveldbDeleteFile));
 }
 
 void cleanupLeveldb() {
+  for (auto& pending : pendingOpens) {
+    delete pending.second.get().db;
+  }
+  pendingOpens.clear();
+  openStats.clear();
+  waitForDumpJobs(-1);
+  dumpJobs.clear();
   iterators.clear();
   dbs.clear();
 }
@@ -0,0 +1,412 @@
+#include "sharded-db.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdlib>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <leveldb/comparator.h>
+#include <leveldb/write_batch.h>
+#include "table/merger.h"
+#include "util/hash.h"
+
+// Runs tasks in order, on a thread of its own.
+class WorkQueue {
+ public:
+  ~WorkQueue() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stopping_ = true;
+    }
+    cv_.notify_one();
+    if (thread_.joinable()) {
+      thread_.join();
+    }
+  }
+
+  // Starts the thread, unless it is running already. Returns false if it could not be started.
+  bool Start() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!thread_.joinable()) {
+      try {
+        thread_ = std::thread(&WorkQueue::Run, this);
+      } catch (const std::system_error&) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // REQUIRES: Start() succeeded.
+  void Schedule(std::function<void()> task) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    queue_.push(std::move(task));
+    cv_.notify_one();
+  }
+
+ private:
+  void Run() {
+    while (true) {
+      std::unique_lock<std::mutex> lock(mutex_);
+      cv_.wait(lock, [this] { return stopping_ || !queue_.empty(); });
+      if (queue_.empty()) {
+        return;
+      }
+      auto task = std::move(queue_.front());
+      queue_.pop();
+      lock.unlock();
+      task();
+    }
+  }
+
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::queue<std::function<void()>> queue_;
+  bool stopping_ = false;
+  std::thread thread_;
+};
+
+// Runs the background work (i.e. compactions) of one shard on a thread of its own. Env::Default() has a single
+// background thread shared by all DBs in the process, which would serialize the compactions of all shards.
+class ShardEnv : public leveldb::EnvWrapper {
+ public:
+  ShardEnv() : leveldb::EnvWrapper(leveldb::Env::Default()) {}
+
+  void Schedule(void (*function)(void*), void* arg) override {
+    // Like Env::Default(), which can't report errors from Schedule either, fail hard if there is no thread.
+    if (!background_.Start()) {
+      std::abort();
+    }
+    background_.Schedule([function, arg] { function(arg); });
+  }
+
+ private:
+  WorkQueue background_;
+};
+
+// Holds one snapshot per shard.
+class ShardedSnapshot : public leveldb::Snapshot {
+ public:
+  std::vector<const leveldb::Snapshot*> snapshots;
+};
+
+namespace {
+
+const char* kShardsFile = "/SHARDS";
+const size_t kDefaultBlockCacheSize = 8 << 20;  // Same as a single leveldb::DB's default.
+
+std::string shardPath(const std::string& path, size_t shard) {
+  return path + "/shard-" + std::to_string(shard);
+}
+
+// The SHARDS file holds the number of shards on its first line, followed by the prefix delimiter.
+leveldb::Status readShardsFile(const std::string& path, int* numShards, std::string* prefixDelimiter) {
+  std::string contents;
+  leveldb::Status status = leveldb::ReadFileToString(leveldb::Env::Default(), path + kShardsFile, &contents);
+  if (!status.ok()) {
+    return status;
+  }
+  size_t newline = contents.find('\n');
+  if (newline == std::string::npos) {
+    return leveldb::Status::Corruption(path + kShardsFile, "missing newline");
+  }
+  *numShards = std::atoi(contents.substr(0, newline).c_str());
+  *prefixDelimiter = contents.substr(newline + 1);
+  if (*numShards <= 0) {
+    return leveldb::Status::Corruption(path + kShardsFile, "invalid number of shards");
+  }
+  return leveldb::Status::OK();
+}
+
+}  // namespace
+
+ShardedDB::ShardedDB(const leveldb::Options& options, const std::string& prefixDelimiter)
+    : comparator_(options.comparator), prefixDelimiter_(prefixDelimiter) {}
+
+ShardedDB::~ShardedDB() {
+  writers_.clear();
+  shards_.clear();
+  envs_.clear();
+}
+
+bool ShardedDB::Exists(const std::string& path) {
+  return leveldb::Env::Default()->FileExists(path + kShardsFile);
+}
+
+leveldb::Status ShardedDB::Open(const leveldb::Options& options, const std::string& path, int numShards,
+                                const std::string& prefixDelimiter, leveldb::DB** dbptr) {
+  *dbptr = nullptr;
+  leveldb::Env* env = leveldb::Env::Default();
+  int storedNumShards = 0;
+  std::string storedPrefixDelimiter;
+  bool exists = Exists(path);
+  if (exists) {
+    if (options.error_if_exists) {
+      return leveldb::Status::InvalidArgument(path, "exists (error_if_exists is true)");
+    }
+    leveldb::Status status = readShardsFile(path, &storedNumShards, &storedPrefixDelimiter);
+    if (!status.ok()) {
+      return status;
+    }
+    if (numShards == 0) {
+      numShards = storedNumShards;
+      if (!prefixDelimiter.empty() && prefixDelimiter != storedPrefixDelimiter) {
+        return leveldb::Status::InvalidArgument(path, "was created with a different delimiter");
+      }
+    } else if (numShards != storedNumShards || prefixDelimiter != storedPrefixDelimiter) {
+      return leveldb::Status::InvalidArgument(path, "was created with a different number of shards or delimiter");
+    }
+  } else {
+    if (!options.create_if_missing) {
+      return leveldb::Status::InvalidArgument(path, "does not exist (create_if_missing is false)");
+    }
+    if (env->FileExists(path + "/CURRENT")) {
+      return leveldb::Status::InvalidArgument(path, "holds a non-sharded DB");
+    }
+    if (numShards <= 0) {
+      return leveldb::Status::InvalidArgument(path, "number of shards must be positive");
+    }
+    env->CreateDir(path);  // Ignore the error, the directory may already exist.
+  }
+
+  std::unique_ptr<ShardedDB> db(new ShardedDB(options, exists ? storedPrefixDelimiter : prefixDelimiter));
+  leveldb::Options shardOptions = options;
+  if (!shardOptions.block_cache) {
+    // Share one cache between all shards, instead of each shard allocating its own.
+    db->blockCache_.reset(leveldb::NewLRUCache(kDefaultBlockCacheSize));
+    shardOptions.block_cache = db->blockCache_.get();
+  }
+  for (int i = 0; i < numShards; ++i) {
+    db->writers_.push_back(std::make_unique<WorkQueue>());
+    if (!db->writers_.back()->Start()) {
+      return leveldb::Status::IOError(path, "could not start a writer thread");
+    }
+    db->envs_.push_back(std::make_unique<ShardEnv>());
+    shardOptions.env = db->envs_.back().get();
+    leveldb::DB* shard;
+    leveldb::Status status = leveldb::DB::Open(shardOptions, shardPath(path, i), &shard);
+    if (!status.ok()) {
+      return status;
+    }
+    db->shards_.push_back(std::unique_ptr<leveldb::DB>{shard});
+  }
+
+  // The SHARDS file is written last, so a DB whose creation was interrupted is simply created again.
+  if (!exists) {
+    std::string contents = std::to_string(numShards) + "\n" + prefixDelimiter;
+    leveldb::Status status = leveldb::WriteStringToFile(env, contents, path + kShardsFile);
+    if (!status.ok()) {
+      return status;
+    }
+  }
+
+  *dbptr = db.release();
+  return leveldb::Status::OK();
+}
+
+leveldb::Status ShardedDB::Destroy(const std::string& path, const leveldb::Options& options) {
+  int numShards;
+  std::string prefixDelimiter;
+  leveldb::Status status = readShardsFile(path, &numShards, &prefixDelimiter);
+  if (!status.ok()) {
+    return status;
+  }
+  for (int i = 0; i < numShards; ++i) {
+    status = leveldb::DestroyDB(shardPath(path, i), options);
+    if (!status.ok()) {
+      return status;
+    }
+  }
+
+  leveldb::Env* env = leveldb::Env::Default();
+  status = env->RemoveFile(path + kShardsFile);
+  if (!status.ok()) {
+    return status;
+  }
+  env->RemoveDir(path);  // Ignore the error, like DestroyDB does.
+  return leveldb::Status::OK();
+}
+
+size_t ShardedDB::ShardFor(const leveldb::Slice& key) const {
+  size_t len = key.size();
+  if (!prefixDelimiter_.empty()) {
+    std::string_view keyView(key.data(), key.size());
+    size_t pos = keyView.find(prefixDelimiter_);
+    if (pos != std::string_view::npos) {
+      len = pos;
+    }
+  }
+  return leveldb::Hash(key.data(), len, 0x5ba7d1e5) % shards_.size();
+}
+
+leveldb::ReadOptions ShardedDB::ShardReadOptions(const leveldb::ReadOptions& options, size_t shard) const {
+  leveldb::ReadOptions shardOptions = options;
+  if (options.snapshot) {
+    shardOptions.snapshot = static_cast<const ShardedSnapshot*>(options.snapshot)->snapshots[shard];
+  }
+  return shardOptions;
+}
+
+template <typename Fn>
+void ShardedDB::ForEachShardParallel(const std::vector<size_t>& shards, Fn fn) {
+  // The first shard's work runs on the calling thread, the others on their shard's writer thread.
+  std::mutex mutex;
+  std::condition_variable done;
+  size_t pending = shards.empty() ? 0 : shards.size() - 1;
+  for (size_t i = 1; i < shards.size(); ++i) {
+    writers_[shards[i]]->Schedule([&, i] {
+      fn(i);
+      std::lock_guard<std::mutex> lock(mutex);
+      if (--pending == 0) {
+        done.notify_one();
+      }
+    });
+  }
+  if (!shards.empty()) {
+    fn(0);
+  }
+  std::unique_lock<std::mutex> lock(mutex);
+  done.wait(lock, [&] { return pending == 0; });
+}
+
+leveldb::Status ShardedDB::Put(const leveldb::WriteOptions& options, const leveldb::Slice& key,
+                               const leveldb::Slice& value) {
+  std::shared_lock<std::shared_mutex> lock(writeMutex_);
+  return shards_[ShardFor(key)]->Put(options, key, value);
+}
+
+leveldb::Status ShardedDB::Delete(const leveldb::WriteOptions& options, const leveldb::Slice& key) {
+  std::shared_lock<std::shared_mutex> lock(writeMutex_);
+  return shards_[ShardFor(key)]->Delete(options, key);
+}
+
+leveldb::Status ShardedDB::Write(const leveldb::WriteOptions& options, leveldb::WriteBatch* updates) {
+  // Splits the batch into one batch per shard.
+  class Splitter : public leveldb::WriteBatch::Handler {
+   public:
+    Splitter(const ShardedDB* db, std::vector<leveldb::WriteBatch>* batches) : db_(db), batches_(batches) {}
+    void Put(const leveldb::Slice& key, const leveldb::Slice& value) override {
+      (*batches_)[db_->ShardFor(key)].Put(key, value);
+    }
+    void Delete(const leveldb::Slice& key) override {
+      (*batches_)[db_->ShardFor(key)].Delete(key);
+    }
+
+   private:
+    const ShardedDB* db_;
+    std::vector<leveldb::WriteBatch>* batches_;
+  };
+
+  std::vector<leveldb::WriteBatch> batches(shards_.size());
+  Splitter splitter(this, &batches);
+  leveldb::Status status = updates->Iterate(&splitter);
+  if (!status.ok()) {
+    return status;
+  }
+
+  std::vector<size_t> touched;
+  for (size_t i = 0; i < batches.size(); ++i) {
+    // An empty WriteBatch only holds its 12 byte header.
+    if (batches[i].ApproximateSize() > 12) {
+      touched.push_back(i);
+    }
+  }
+
+  std::shared_lock<std::shared_mutex> lock(writeMutex_);
+  std::vector<leveldb::Status> statuses(touched.size());
+  ForEachShardParallel(touched, [&](size_t i) {
+    statuses[i] = shards_[touched[i]]->Write(options, &batches[touched[i]]);
+  });
+  for (auto& shardStatus : statuses) {
+    if (!shardStatus.ok()) {
+      return shardStatus;
+    }
+  }
+  return leveldb::Status::OK();
+}
+
+leveldb::Status ShardedDB::Get(const leveldb::ReadOptions& options, const leveldb::Slice& key, std::string* value) {
+  size_t shard = ShardFor(key);
+  return shards_[shard]->Get(ShardReadOptions(options, shard), key, value);
+}
+
+leveldb::Iterator* ShardedDB::NewIterator(const leveldb::ReadOptions& options) {
+  std::vector<leveldb::Iterator*> children;
+  {
+    // Without a snapshot, each shard's iterator uses its own implicit one; they are created under the exclusive
+    // lock so that they all match.
+    std::unique_lock<std::shared_mutex> lock(writeMutex_, std::defer_lock);
+    if (!options.snapshot) {
+      lock.lock();
+    }
+    for (size_t i = 0; i < shards_.size(); ++i) {
+      children.push_back(shards_[i]->NewIterator(ShardReadOptions(options, i)));
+    }
+  }
+  return leveldb::NewMergingIterator(comparator_, children.data(), (int)children.size());
+}
+
+const leveldb::Snapshot* ShardedDB::GetSnapshot() {
+  std::unique_lock<std::shared_mutex> lock(writeMutex_);
+  auto snapshot = new ShardedSnapshot();
+  for (auto& shard : shards_) {
+    snapshot->snapshots.push_back(shard->GetSnapshot());
+  }
+  return snapshot;
+}
+
+void ShardedDB::ReleaseSnapshot(const leveldb::Snapshot* snapshot) {
+  auto sharded = static_cast<const ShardedSnapshot*>(snapshot);
+  for (size_t i = 0; i < shards_.size(); ++i) {
+    shards_[i]->ReleaseSnapshot(sharded->snapshots[i]);
+  }
+  delete sharded;
+}
+
+bool ShardedDB::GetProperty(const leveldb::Slice& property, std::string* value) {
+  // Numeric properties are summed over the shards; others are listed one per shard.
+  std::vector<std::string> values(shards_.size());
+  bool numeric = true;
+  uint64_t sum = 0;
+  for (size_t i = 0; i < shards_.size(); ++i) {
+    if (!shards_[i]->GetProperty(property, &values[i])) {
+      return false;
+    }
+    char* end;
+    sum += std::strtoull(values[i].c_str(), &end, 10);
+    numeric = numeric && !values[i].empty() && *end == '\0';
+  }
+
+  if (numeric) {
+    *value = std::to_string(sum);
+    return true;
+  }
+  value->clear();
+  for (size_t i = 0; i < values.size(); ++i) {
+    *value += "shard " + std::to_string(i) + ":\n" + values[i];
+  }
+  return true;
+}
+
+void ShardedDB::GetApproximateSizes(const leveldb::Range* range, int n, uint64_t* sizes) {
+  std::vector<uint64_t> shardSizes(n);
+  std::fill(sizes, sizes + n, 0);
+  for (auto& shard : shards_) {
+    shard->GetApproximateSizes(range, n, shardSizes.data());
+    for (int i = 0; i < n; ++i) {
+      sizes[i] += shardSizes[i];
+    }
+  }
+}
+
+void ShardedDB::CompactRange(const leveldb::Slice* begin, const leveldb::Slice* end) {
+  std::vector<size_t> all(shards_.size());
+  for (size_t i = 0; i < all.size(); ++i) {
+    all[i] = i;
+  }
+  ForEachShardParallel(all, [&](size_t i) { shards_[i]->CompactRange(begin, end); });
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <vector>
+#include <leveldb/cache.h>
+#include <leveldb/db.h>
+#include <leveldb/env.h>
+
+class ShardEnv;
+class WorkQueue;
+
+// A leveldb::DB that spreads its keys over several underlying DBs ("shards"), stored as subdirectories of one path.
+// Every shard has its own write queue, memtable and background compaction thread, so work on different shards runs in
+// parallel. A key is assigned to a shard by hashing it, or only the part before `prefixDelimiter` (when set), which
+// keeps all keys sharing that prefix in the same shard.
+//
+// Iterators merge the shards in key order. A WriteBatch is split by shard and the parts are written concurrently, on
+// a persistent writer thread per shard: snapshots and iterators see either all or none of it, but after a crash only
+// some shards may have applied it.
+class ShardedDB : public leveldb::DB {
+ public:
+  // Opens the sharded DB at `path`. `numShards` = 0 opens an existing sharded DB with its stored number of shards.
+  // `prefixDelimiter` must match the one it was created with, unless it is empty and `numShards` = 0; a non-zero
+  // `numShards` must match, too.
+  static leveldb::Status Open(const leveldb::Options& options, const std::string& path, int numShards,
+                              const std::string& prefixDelimiter, leveldb::DB** dbptr);
+
+  // Returns true if `path` holds a sharded DB.
+  static bool Exists(const std::string& path);
+
+  // Destroys the contents of the sharded DB at `path`, like leveldb::DestroyDB does for a single one.
+  static leveldb::Status Destroy(const std::string& path, const leveldb::Options& options);
+
+  ~ShardedDB() override;
+
+  leveldb::Status Put(const leveldb::WriteOptions& options, const leveldb::Slice& key,
+                      const leveldb::Slice& value) override;
+  leveldb::Status Delete(const leveldb::WriteOptions& options, const leveldb::Slice& key) override;
+  leveldb::Status Write(const leveldb::WriteOptions& options, leveldb::WriteBatch* updates) override;
+  leveldb::Status Get(const leveldb::ReadOptions& options, const leveldb::Slice& key, std::string* value) override;
+  leveldb::Iterator* NewIterator(const leveldb::ReadOptions& options) override;
+  const leveldb::Snapshot* GetSnapshot() override;
+  void ReleaseSnapshot(const leveldb::Snapshot* snapshot) override;
+  bool GetProperty(const leveldb::Slice& property, std::string* value) override;
+  void GetApproximateSizes(const leveldb::Range* range, int n, uint64_t* sizes) override;
+  void CompactRange(const leveldb::Slice* begin, const leveldb::Slice* end) override;
+
+ private:
+  ShardedDB(const leveldb::Options& options, const std::string& prefixDelimiter);
+
+  size_t ShardFor(const leveldb::Slice& key) const;
+  // Runs fn(i) for every i in [0, shards.size()) in parallel, on the writer thread of shards[i].
+  template <typename Fn>
+  void ForEachShardParallel(const std::vector<size_t>& shards, Fn fn);
+  leveldb::ReadOptions ShardReadOptions(const leveldb::ReadOptions& options, size_t shard) const;
+
+  const leveldb::Comparator* comparator_;
+  std::string prefixDelimiter_;
+
+  // Writes hold this shared; snapshots and iterators take it exclusively, so that they see the same point in time
+  // on every shard.
+  std::shared_mutex writeMutex_;
+
+  // Destruction order matters: the shards must be closed before their cache and background threads go away.
+  std::unique_ptr<leveldb::Cache> blockCache_;
+  std::vector<std::unique_ptr<ShardEnv>> envs_;
+  std::vector<std::unique_ptr<leveldb::DB>> shards_;
+  std::vector<std::unique_ptr<WorkQueue>> writers_;
+};
@@ -6,7 +6,7 @@ import {
   BenchmarkResults,
   BenchmarkResultsView
 } from "./benchmark";
-import {leveldbExample, leveldbTests} from "./example";
+import {leveldbExample, leveldbTestExportImport, leveldbTestOpenAsync, leveldbTests} from "./example";
 
 interface BenchmarkState {
   leveldb?: BenchmarkResults;
@@ -27,6 +27,16 @@ export default class App extends React.Component<{}, BenchmarkState> {
         leveldbTests: leveldbTests(),
       });
 
+      for (const [name, test] of [
+        ['leveldbTestOpenAsync', leveldbTestOpenAsync],
+        ['leveldbTestExportImport', leveldbTestExportImport],
+      ] as [string, () => Promise<string[]>][]) {
+        test().then(
+          res => res.length ? `${name} failed with:` + res.join('; ') : `${name} succeeded`,
+          e => `${name} threw: ` + e.message,
+        ).then(msg => this.setState(state => ({leveldbTests: [...state.leveldbTests, msg]})));
+      }
+
       benchmarkAsyncStorage().then(res => this.setState({asyncStorage: res}));
     } catch (e) {
       console.error('Error running benchmark:', e);
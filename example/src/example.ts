@@ -1,5 +1,5 @@
 import {LevelDB} from "react-native-leveldb";
-import {bufEquals, getRandomString} from "./test-util";
+import {bufEquals, getRandomString, makeDump} from "./test-util";
 
 export function leveldbExample(): boolean {
   // Open a potentially new database.
@@ -80,6 +80,258 @@ export function leveldbTestMerge(batchMerge: boolean) {
   return errors;
 }
 
+export function leveldbTestRanges() {
+  const name = getRandomString(32) + '.db';
+  console.info('leveldbTestRanges: Opening DB', name);
+  const db = new LevelDB(name, true, true);
+  for (let i = 0; i < 2500; ++i) {
+    db.put(`session.${i}`, 'value');
+  }
+  db.put('settings', 'value');
+  db.put('user', 'value');
+
+  const errors: string[] = [];
+  if (db.countRange({prefix: 'session.'}) != 2500) {
+    errors.push(`countRange(prefix) returned: ${db.countRange({prefix: 'session.'})}`);
+  }
+  if (db.countRange({prefix: 'session.'}, 10) != 10) {
+    errors.push(`countRange(prefix, 10) returned: ${db.countRange({prefix: 'session.'}, 10)}`);
+  }
+  if (db.countRange({start: 'settings', end: 'user'}) != 1) {
+    errors.push(`countRange(start, end) returned: ${db.countRange({start: 'settings', end: 'user'})}`);
+  }
+  if (db.approximateSize() < 0) {
+    errors.push(`approximateSize returned: ${db.approximateSize()}`);
+  }
+
+  const deleted = db.clearRange({prefix: 'session.'});
+  if (deleted != 2500) {
+    errors.push(`clearRange(prefix) deleted: ${deleted}`);
+  }
+  if (db.countRange() != 2 || db.getStr('settings') != 'value' || db.getStr('user') != 'value') {
+    errors.push(`clearRange(prefix) left ${db.countRange()} keys`);
+  }
+
+  db.close();
+  LevelDB.destroyDB(name);
+  return errors;
+}
+
+export function leveldbTestSharded() {
+  const name = getRandomString(32) + '.db';
+  console.info('leveldbTestSharded: Opening DB', name);
+  let db = new LevelDB(name, true, true, {shards: 4, shardPrefixDelimiter: ':'});
+  const keys: string[] = [];
+  for (let i = 0; i < 1000; ++i) {
+    keys.push(`${i % 10}:${i}`);
+    db.put(keys[i]!, `value${i}`);
+  }
+  keys.sort();
+
+  const errors: string[] = [];
+  if (db.getStr('7:17') != 'value17') {
+    errors.push(`7:17 didn't have expected value: ${db.getStr('7:17')}`);
+  }
+
+  // Iteration merges the shards back into key order.
+  const iterated: string[] = [];
+  const iter = db.newIterator();
+  for (iter.seekToFirst(); iter.valid(); iter.next()) {
+    iterated.push(iter.keyStr());
+  }
+  iter.close();
+  if (iterated.join() != keys.join()) {
+    errors.push(`iteration returned ${iterated.length} keys, not in order`);
+  }
+  if (db.countRange({prefix: '3:'}) != 100) {
+    errors.push(`countRange(prefix) returned: ${db.countRange({prefix: '3:'})}`);
+  }
+
+  // Re-opening without options picks up the stored sharding.
+  db.close();
+  db = new LevelDB(name, false, false);
+  if (db.getStr('7:17') != 'value17' || db.countRange() != 1000) {
+    errors.push(`re-opened DB has ${db.countRange()} keys`);
+  }
+  db.close();
+  LevelDB.destroyDB(name);
+  return errors;
+}
+
+export function leveldbTestIndexes() {
+  const name = getRandomString(32) + '.db';
+  console.info('leveldbTestIndexes: Opening DB', name);
+  let db = new LevelDB(name, true, true);
+  const errors: string[] = [];
+  for (let i = 0; i < 100; ++i) {
+    db.put(`user:${i}`, JSON.stringify({age: i % 10, address: {city: i % 2 ? 'Athens' : 'Berlin'}}));
+  }
+
+  // Keys reserved for indexes can't be written, even before any index exists.
+  const reservedKey = new Uint8Array([0xff, 0xff, ...Array.from('idx:def:age', c => c.charCodeAt(0))]);
+  try {
+    db.put(reservedKey.buffer, 'json\nage');
+    errors.push('put() of a reserved key did not throw');
+  } catch (e: any) {
+  }
+
+  // Existing records are indexed when the index is created.
+  db.createIndex('age', {jsonPath: 'age'});
+  db.createIndex('city', {jsonPath: 'address.city'});
+  if (db.countRange() != 100) {
+    errors.push(`countRange() with indexes returned: ${db.countRange()}`);
+  }
+  let res = db.indexScanStr('age', {equals: 3});
+  if (res.length != 10 || res[0]![0] != 'user:13' || JSON.parse(res[0]![1]).age != 3) {
+    errors.push(`indexScanStr(equals: 3) returned: ${JSON.stringify(res.slice(0, 2))}...`);
+  }
+  res = db.indexScanStr('age', {gte: 8}, 5);
+  if (res.length != 5 || res.some(([_, v]) => JSON.parse(v).age != 8)) {
+    errors.push(`indexScanStr(gte: 8, limit 5) returned: ${JSON.stringify(res)}`);
+  }
+
+  // Writes keep the indexes up to date.
+  db.put('user:13', JSON.stringify({age: 30, address: {city: 'Berlin'}}));
+  db.delete('user:23');
+  if (db.indexScanStr('age', {equals: 3}).length != 8) {
+    errors.push(`indexScanStr(equals: 3) after writes returned ${db.indexScanStr('age', {equals: 3}).length} records`);
+  }
+  res = db.indexScanStr('age', {gt: 9});
+  if (res.length != 1 || res[0]![0] != 'user:13') {
+    errors.push(`indexScanStr(gt: 9) returned: ${JSON.stringify(res)}`);
+  }
+  if (db.indexScanStr('city', {equals: 'Athens'}).length != 48) {
+    errors.push(`indexScanStr(city) returned ${db.indexScanStr('city', {equals: 'Athens'}).length} records`);
+  }
+
+  // Index definitions are stored in the DB.
+  db.close();
+  db = new LevelDB(name, false, false);
+  db.put('user:1000', JSON.stringify({age: 3}));
+  if (db.indexScanStr('age', {equals: 3}).length != 9) {
+    errors.push(`indexScanStr after re-opening returned ${db.indexScanStr('age', {equals: 3}).length} records`);
+  }
+  db.dropIndex('age');
+  try {
+    db.indexScanStr('age');
+    errors.push('indexScanStr on a dropped index did not throw');
+  } catch (e: any) {
+  }
+
+  db.close();
+  LevelDB.destroyDB(name);
+  return errors;
+}
+
+export async function leveldbTestOpenAsync() {
+  const name = getRandomString(32) + '.db';
+  console.info('leveldbTestOpenAsync: Opening DB', name);
+  let db = new LevelDB(name, true, true);
+  for (let i = 0; i < 1000; ++i) {
+    db.put(`key${i}`, `value${i}`);
+  }
+  db.close();
+
+  const errors: string[] = [];
+  db = LevelDB.openAsync(name, false, false, {prewarm: [{prefix: 'key1'}]});
+  const stats = await db.ready();
+  if (!stats.ready || stats.prewarmBytes <= 0) {
+    errors.push(`unexpected open stats: ${JSON.stringify(stats)}`);
+  }
+  if (db.getStr('key17') != 'value17') {
+    errors.push(`key17 didn't have expected value: ${db.getStr('key17')}`);
+  }
+  db.close();
+
+  // Calls made before the DB is open wait for it.
+  db = LevelDB.openAsync(name, false, false);
+  if (db.getStr('key17') != 'value17') {
+    errors.push(`key17 read before ready() didn't have expected value: ${db.getStr('key17')}`);
+  }
+  db.close();
+
+  const missingName = getRandomString(32) + '.db';
+  db = LevelDB.openAsync(missingName, false, false);
+  try {
+    await db.ready();
+    errors.push('ready() of a missing DB did not reject');
+  } catch (e: any) {
+  }
+  // The failed open is forgotten, so opening the name again retries.
+  db = new LevelDB(missingName, true, false);
+  db.put('key', 'value');
+  if (db.getStr('key') != 'value') {
+    errors.push(`re-opening after a failed openAsync() returned: ${db.getStr('key')}`);
+  }
+  db.close();
+  LevelDB.destroyDB(missingName);
+
+  LevelDB.destroyDB(name);
+  return errors;
+}
+
+export async function leveldbTestExportImport() {
+  const nameSrc = getRandomString(32) + '.db';
+  console.info('leveldbTestExportImport: Opening DB', nameSrc);
+  const dbSrc = new LevelDB(nameSrc, true, true);
+  for (let i = 0; i < 5000; ++i) {
+    dbSrc.put(`key${i}`, getRandomString(100));
+  }
+  const binaryKey = new Uint8Array([0, 255, 1]);
+  dbSrc.put(binaryKey.buffer, binaryKey.buffer);
+
+  const errors: string[] = [];
+  const dumpPath = nameSrc + '.dump';
+  const exported = await dbSrc.exportToFile(dumpPath, {compress: true});
+  if (exported.entries != 5001) {
+    errors.push(`exported ${exported.entries} entries`);
+  }
+
+  const nameDst = getRandomString(32) + '.db';
+  const dbDst = new LevelDB(nameDst, true, true, {writeBufferSize: 64 << 20});
+  const imported = await dbDst.importFromFile(dumpPath);
+  if (imported.entries != 5001 || dbDst.countRange() != 5001) {
+    errors.push(`imported ${imported.entries} entries, DB has ${dbDst.countRange()}`);
+  }
+  if (dbDst.getStr('key17') != dbSrc.getStr('key17')) {
+    errors.push(`key17 didn't have expected value: ${dbDst.getStr('key17')}`);
+  }
+  if (!bufEquals(dbDst.getBuf(binaryKey.buffer)!, binaryKey.buffer)) {
+    errors.push(`binary key didn't have expected value: ${new Uint8Array(dbDst.getBuf(binaryKey.buffer)!)}`);
+  }
+
+  try {
+    await dbDst.importFromFile(nameSrc + '.missing');
+    errors.push('importing a missing file did not reject');
+  } catch (e: any) {
+  }
+
+  // Keys reserved for indexes are rejected before anything is written, whether or not the DB has indexes.
+  const ascii = (str: string) => new Uint8Array(Array.from(str, c => c.charCodeAt(0)));
+  const reservedKey = new Uint8Array([0xff, 0xff, ...ascii('idx:def:age')]);
+  const reservedPath = nameSrc + '.reserved.dump';
+  LevelDB.writeBufToFile(reservedPath, makeDump([
+    [ascii('reserved0'), ascii('value')],
+    [reservedKey, ascii('json\nage')],
+  ]));
+  try {
+    await dbDst.importFromFile(reservedPath);
+    errors.push('importing a dump with a reserved key did not reject');
+  } catch (e: any) {
+  }
+  if (dbDst.getStr('reserved0') !== null) {
+    errors.push('importing a dump with a reserved key wrote some of its entries');
+  }
+
+  dbSrc.close();
+  dbDst.close();
+  LevelDB.destroyDB(nameSrc);
+  LevelDB.destroyDB(nameDst);
+  LevelDB.deleteFile(dumpPath);
+  LevelDB.deleteFile(reservedPath);
+  return errors;
+}
+
 export function leveldbTests() {
   let s: string[] = [];
   try {
@@ -118,5 +370,38 @@ export function leveldbTests() {
     s.push('leveldbTestMerge(false) threw: ' + e.message);
   }
 
+  try {
+    const res = leveldbTestRanges();
+    if (res.length) {
+      s.push('leveldbTestRanges failed with:' + res.join('; '));
+    } else {
+      s.push('leveldbTestRanges succeeded');
+    }
+  } catch (e: any) {
+    s.push('leveldbTestRanges threw: ' + e.message);
+  }
+
+  try {
+    const res = leveldbTestSharded();
+    if (res.length) {
+      s.push('leveldbTestSharded failed with:' + res.join('; '));
+    } else {
+      s.push('leveldbTestSharded succeeded');
+    }
+  } catch (e: any) {
+    s.push('leveldbTestSharded threw: ' + e.message);
+  }
+
+  try {
+    const res = leveldbTestIndexes();
+    if (res.length) {
+      s.push('leveldbTestIndexes failed with:' + res.join('; '));
+    } else {
+      s.push('leveldbTestIndexes succeeded');
+    }
+  } catch (e: any) {
+    s.push('leveldbTestIndexes threw: ' + e.message);
+  }
+
   return s;
 }
@@ -55,4 +55,61 @@ export function bufEquals(a_: ArrayBuffer, b_: ArrayBuffer) {
   }
 
   return true;
-}
\ No newline at end of file
+}
+let crc32cTable: undefined | Uint32Array;
+
+function crc32c(data: Uint8Array): number {
+  if (!crc32cTable) {
+    crc32cTable = new Uint32Array(256);
+    for (let i = 0; i < 256; ++i) {
+      let c = i;
+      for (let k = 0; k < 8; ++k) {
+        c = c & 1 ? (c >>> 1) ^ 0x82f63b78 : c >>> 1;
+      }
+      crc32cTable[i] = c;
+    }
+  }
+  let crc = 0xffffffff;
+  for (let i = 0; i < data.length; ++i) {
+    crc = crc32cTable[(crc ^ data[i]!) & 0xff]! ^ (crc >>> 8);
+  }
+  return (crc ^ 0xffffffff) >>> 0;
+}
+
+// Builds an uncompressed dump file, in the format written by LevelDB.exportToFile(), holding `entries`.
+export function makeDump(entries: [Uint8Array, Uint8Array][]): ArrayBuffer {
+  const bytes: number[] = [];
+  const pushFixed32 = (dst: number[], v: number) => dst.push(v & 0xff, (v >>> 8) & 0xff, (v >>> 16) & 0xff, v >>> 24);
+  const pushVarint32 = (dst: number[], v: number) => {
+    for (; v >= 0x80; v >>>= 7) {
+      dst.push((v & 0x7f) | 0x80);
+    }
+    dst.push(v);
+  };
+  const pushChunk = (type: number, payload: number[]) => {
+    const crc = crc32c(new Uint8Array(payload));
+    bytes.push(type);
+    pushFixed32(bytes, payload.length);
+    pushFixed32(bytes, payload.length);
+    pushFixed32(bytes, ((((crc >>> 15) | (crc << 17)) >>> 0) + 0xa282ead8) >>> 0);
+    bytes.push(...payload);
+  };
+
+  for (const c of 'RNLDBDMP') {
+    bytes.push(c.charCodeAt(0));
+  }
+  pushFixed32(bytes, 1);
+  const chunk: number[] = [];
+  for (const [key, value] of entries) {
+    pushVarint32(chunk, key.length);
+    chunk.push(...key);
+    pushVarint32(chunk, value.length);
+    chunk.push(...value);
+  }
+  pushChunk(0, chunk);
+  const end: number[] = [];
+  pushFixed32(end, entries.length);
+  pushFixed32(end, 0);
+  pushChunk(2, end);
+  return new Uint8Array(bytes).buffer;
+}
@@ -35,3 +35,27 @@ test('FakeLevelDB', () => {
   expect(db.kv?.map(x => toString(x[0]))).toEqual(['db.farm.0', 'db.farm.1', 'dbMeta', 'dbMetaverse'])
   expect(db.getStr('dbMeta')).toEqual('f');
 });
+
+
+test('FakeLevelDB ranges', () => {
+  const db = new FakeLevelDB();
+  for (const k of ['a', 'b.1', 'b.2', 'b.3', 'c']) {
+    db.put(k, 'v');
+  }
+  db.put(new Uint8Array([0x62, 0xff]).buffer, 'v');
+
+  expect(db.countRange()).toEqual(6);
+  expect(db.countRange({prefix: 'b.'})).toEqual(3);
+  expect(db.countRange({prefix: 'b'})).toEqual(4);
+  expect(db.countRange({start: 'b', end: 'c'})).toEqual(4);
+  expect(db.countRange({start: 'b.2'})).toEqual(3);
+  expect(db.countRange({prefix: 'b.'}, 2)).toEqual(2);
+  expect(db.approximateSize({prefix: 'b.'})).toEqual(12);
+
+  expect(db.clearRange({prefix: 'b.'})).toEqual(3);
+  expect(db.kv?.map(x => toString(x[0]))).toEqual(['a', toString(new Uint8Array([0x62, 0xff]).buffer), 'c']);
+  expect(db.clearRange({end: 'c'})).toEqual(2);
+  expect(db.kv?.map(x => toString(x[0]))).toEqual(['c']);
+  expect(db.clearRange()).toEqual(1);
+  expect(db.countRange()).toEqual(0);
+});
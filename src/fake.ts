@@ -1,4 +1,4 @@
-import type { LevelDBI, LevelDBIteratorI } from "./index";
+import type { LevelDBI, LevelDBIteratorI, LevelDBRange } from "./index";
 
 // Return the position at the first key in the source that is at or past `k`.
 function getIdx(kv: null | [ArrayBuffer, ArrayBuffer][], k: ArrayBuffer | string, start?: number, end?: number): number {
@@ -28,6 +28,36 @@ function getIdx(kv: null | [ArrayBuffer, ArrayBuffer][], k: ArrayBuffer | string
   }
 }
 
+// Return the [start, end) positions of the keys within `range`.
+function getRangeIdx(kv: null | [ArrayBuffer, ArrayBuffer][], range?: LevelDBRange): [number, number] {
+  if (!kv) {
+    throw new Error('FakeLevelDB was closed!');
+  }
+
+  let start = range?.start, end = range?.end;
+  if (range?.prefix !== undefined) {
+    if (start !== undefined || end !== undefined) {
+      throw new Error('FakeLevelDB: a range can have either a prefix or start/end');
+    }
+    start = range.prefix;
+    // The smallest key past all keys with this prefix: strip trailing 0xff bytes and increment the last one.
+    const bytes = new Uint8Array(toArraybuf(start));
+    let len = bytes.length;
+    while (len > 0 && bytes[len - 1] === 0xff) {
+      len--;
+    }
+    if (len > 0) {
+      const endBytes = bytes.slice(0, len);
+      endBytes[len - 1]!++;
+      end = endBytes.buffer;
+    }
+  }
+
+  const startIdx = start === undefined ? 0 : getIdx(kv, start);
+  const endIdx = end === undefined ? kv.length : getIdx(kv, end);
+  return [startIdx, Math.max(startIdx, endIdx)];
+}
+
 export class FakeLevelDBIterator implements LevelDBIteratorI {
   private kv: [ArrayBuffer, ArrayBuffer][];
   private pos: undefined | number;
@@ -198,4 +228,20 @@ export class FakeLevelDB implements LevelDBI {
   newIterator(): LevelDBIteratorI {
     return new FakeLevelDBIterator(this);
   }
+
+  clearRange(range?: LevelDBRange, _batchSize?: number): number {
+    const [start, end] = getRangeIdx(this.kv, range);
+    this.kv!.splice(start, end - start);
+    return end - start;
+  }
+
+  countRange(range?: LevelDBRange, limit?: number): number {
+    const [start, end] = getRangeIdx(this.kv, range);
+    return limit ? Math.min(limit, end - start) : end - start;
+  }
+
+  approximateSize(range?: LevelDBRange): number {
+    const [start, end] = getRangeIdx(this.kv, range);
+    return this.kv!.slice(start, end).reduce((size, [k, v]) => size + k.byteLength + v.byteLength, 0);
+  }
 }
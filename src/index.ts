@@ -17,6 +17,25 @@ try {
 
 const g = global as any;
 
+// Calls `check` every `pollIntervalMs` until it returns a result, without blocking the JS thread in between.
+function pollUntil<T>(check: () => undefined | T, pollIntervalMs: number): Promise<T> {
+  return new Promise((resolve, reject) => {
+    const poll = () => {
+      try {
+        const result = check();
+        if (result === undefined) {
+          setTimeout(poll, pollIntervalMs);
+        } else {
+          resolve(result);
+        }
+      } catch (e) {
+        reject(e);
+      }
+    };
+    poll();
+  });
+}
+
 export interface LevelDBIteratorI {
   // Position at the first key in the source.  The iterator is Valid()
   // after this call iff the source is not empty.
@@ -67,6 +86,80 @@ export interface LevelDBIteratorI {
   compareKey(target: ArrayBuffer | string): number;
 }
 
+// A range of keys: either all keys in [start, end), or all keys starting with `prefix`. Omitted bounds extend to the
+// first/last key of the database.
+export interface LevelDBRange {
+  start?: ArrayBuffer | string;  // Inclusive.
+  end?: ArrayBuffer | string;  // Exclusive.
+  prefix?: ArrayBuffer | string;  // Can't be combined with start or end.
+}
+
+export interface LevelDBOpenOptions {
+  // Spread the keys over this many LevelDB instances ("shards") under the same path. Each shard has its own write
+  // queue, memtable and compaction thread, so heavy write loads can use several cores. Iterators merge the shards,
+  // so the API behaves as for a single DB. A batch of writes (e.g. merge) is split by shard and is no longer
+  // atomic on a crash.
+  // The number of shards is fixed when the DB is created; a sharded DB is recognized and opened as such even if this
+  // option is omitted.
+  shards?: number;
+
+  // With `shards`: assign keys to shards by the part before the first occurrence of this delimiter, instead of by
+  // the whole key. For example, with ':', all 'user:...' keys end up in the same shard.
+  shardPrefixDelimiter?: string;
+
+  // Read these ranges right after opening, so that their blocks are in the block cache when the app first needs
+  // them. Prewarming stops after reading 8MB, the size of the block cache.
+  prewarm?: LevelDBRange[];
+
+  // Size of the in-memory write buffer, in bytes (default: 4MB). A larger buffer, e.g. 64MB, speeds up bulk loads
+  // such as importFromFile(), at the cost of memory and a longer recovery after an unclean shutdown.
+  writeBufferSize?: number;
+}
+
+export interface LevelDBDumpOptions {
+  // exportToFile() only: compress the dump with zlib.
+  compress?: boolean;
+  // Called every time the progress is polled.
+  onProgress?: (progress: LevelDBDumpProgress) => void;
+}
+
+export interface LevelDBDumpProgress {
+  done: boolean;
+  entries: number;
+  // Bytes of keys and values processed so far, before compression.
+  bytes: number;
+}
+
+// How an index derives its field from a stored value: either a path into a JSON value, like 'user.address.city' or
+// 'tags.0', or a range of bytes of the value. Values without the field are not indexed.
+export type LevelDBIndexSpec = { jsonPath: string } | { byteOffset: number; byteLength: number };
+
+// A value to compare index fields with. Byte ranges compare as strings, byte by byte.
+export type LevelDBIndexValue = null | boolean | number | string | ArrayBuffer;
+
+// Bounds of an index scan; omitted bounds are open. Fields sort by type (null < false < true < numbers < strings),
+// then by value.
+export interface LevelDBIndexQuery {
+  equals?: LevelDBIndexValue;
+  gt?: LevelDBIndexValue;
+  gte?: LevelDBIndexValue;
+  lt?: LevelDBIndexValue;
+  lte?: LevelDBIndexValue;
+}
+
+export interface LevelDBOpenStats {
+  // False while LevelDB.openAsync() is still opening the DB.
+  ready: boolean;
+  // Set if LevelDB.openAsync() failed; any other call on the DB will throw.
+  error?: string;
+  // Time spent opening the DB; after an unclean shutdown, this is mostly spent replaying the write-ahead log.
+  openMs: number;
+  prewarmMs: number;
+  prewarmBytes: number;
+  // Time the JS thread was blocked, waiting for LevelDB.openAsync() to finish.
+  blockedMs: number;
+}
+
 export interface LevelDBI {
   // Close this ref to LevelDB.
   close(): void;
@@ -95,6 +188,17 @@ export interface LevelDBI {
   // Caller should delete the iterator when it is no longer needed.
   // The returned iterator should be closed before this db is closed.
   newIterator(): LevelDBIteratorI;
+
+  // Deletes all keys in `range` (or in the whole database, if omitted) and returns how many were deleted.
+  // Deletes are written in batches of `batchSize` keys, so the range as a whole is not cleared atomically.
+  clearRange(range?: LevelDBRange, batchSize?: number): number;
+
+  // Returns the number of keys in `range`, without reading their values. Counting stops at `limit`, if given.
+  countRange(range?: LevelDBRange, limit?: number): number;
+
+  // Returns the approximate size in bytes of the data stored for `range`. Recent writes that are still in memory
+  // are not included.
+  approximateSize(range?: LevelDBRange): number;
 }
 
 export class LevelDBIterator implements LevelDBIteratorI {
@@ -163,26 +267,97 @@ export class LevelDB implements LevelDBI {
   private static openPathRefs: { [name: string]: undefined | number } = {};
   private ref: undefined | number;
 
-  constructor(name: string, createIfMissing: boolean, errorIfExists: boolean) {
+  constructor(name: string, createIfMissing: boolean, errorIfExists: boolean, options?: LevelDBOpenOptions) {
     if (nativeModuleInitError) {
       throw new Error(nativeModuleInitError);
     }
 
+    if (LevelDB.openPathRefs[name] !== undefined && g.leveldbOpenStats(LevelDB.openPathRefs[name]).error) {
+      // A failed openAsync(): release it and try again, instead of reusing the dead ref.
+      LevelDB.forgetRef(LevelDB.openPathRefs[name]!);
+    }
     if (LevelDB.openPathRefs[name] !== undefined) {
       this.ref = LevelDB.openPathRefs[name];
     } else {
-      LevelDB.openPathRefs[name] = this.ref = g.leveldbOpen(name, createIfMissing, errorIfExists);
+      LevelDB.openPathRefs[name] = this.ref = g.leveldbOpen(
+        name, createIfMissing, errorIfExists, options?.shards, options?.shardPrefixDelimiter, options?.prewarm,
+        options?.writeBufferSize);
+    }
+  }
+
+  // Like the constructor, but opens (and prewarms) the DB on a native thread, so that a long recovery doesn't block
+  // the JS thread. The returned DB can be used right away: calls wait until the DB is open. Use ready() to wait
+  // without blocking.
+  static openAsync(name: string, createIfMissing: boolean, errorIfExists: boolean, options?: LevelDBOpenOptions): LevelDB {
+    if (!nativeModuleInitError && LevelDB.openPathRefs[name] === undefined) {
+      LevelDB.openPathRefs[name] = g.leveldbOpenAsync(
+        name, createIfMissing, errorIfExists, options?.shards, options?.shardPrefixDelimiter, options?.prewarm,
+        options?.writeBufferSize);
     }
+    return new LevelDB(name, createIfMissing, errorIfExists, options);
+  }
+
+  // Returns how long opening this DB took. Doesn't block: for a DB that is still opening, `ready` is false.
+  openStats(): LevelDBOpenStats {
+    return g.leveldbOpenStats(this.ref);
+  }
+
+  // Resolves once the DB is open, or closes it and rejects if opening it failed.
+  ready(pollIntervalMs: number = 5): Promise<LevelDBOpenStats> {
+    return pollUntil(() => {
+      const stats = this.openStats();
+      if (stats.error) {
+        this.close();
+        throw new Error('LevelDB.ready: ' + stats.error);
+      }
+      return stats.ready ? stats : undefined;
+    }, pollIntervalMs);
+  }
+
+  // Writes a consistent snapshot of all entries into a checksummed dump file, on a native thread. Relative paths are
+  // relative to the documents directory, like DB names. The DB can be used while the export runs; closing it waits
+  // for the export to finish.
+  exportToFile(path: string, options?: LevelDBDumpOptions, pollIntervalMs: number = 20): Promise<LevelDBDumpProgress> {
+    if (this.ref === undefined) {
+      throw new Error('LevelDB.exportToFile: could not export, the DB was closed!');
+    }
+    return LevelDB.waitForDumpJob(g.leveldbExport(this.ref, path, !!options?.compress), options, pollIntervalMs);
+  }
+
+  // Writes all entries of a dump file made by exportToFile() into this DB, on a native thread, overwriting existing
+  // keys. The dump is validated before anything is written, so a corrupt one is rejected as a whole. Entries are
+  // written in large unsynced batches; if a write fails halfway, the entries written so far remain.
+  importFromFile(path: string, options?: LevelDBDumpOptions, pollIntervalMs: number = 20): Promise<LevelDBDumpProgress> {
+    if (this.ref === undefined) {
+      throw new Error('LevelDB.importFromFile: could not import, the DB was closed!');
+    }
+    return LevelDB.waitForDumpJob(g.leveldbImport(this.ref, path), options, pollIntervalMs);
+  }
+
+  private static waitForDumpJob(job: number, options: undefined | LevelDBDumpOptions,
+                                pollIntervalMs: number): Promise<LevelDBDumpProgress> {
+    return pollUntil(() => {
+      const {error, ...progress} = g.leveldbDumpJobStatus(job);
+      if (error) {
+        throw new Error('LevelDB dump: ' + error);
+      }
+      options?.onProgress?.(progress);
+      return progress.done ? progress : undefined;
+    }, pollIntervalMs);
   }
 
   close() {
-    g.leveldbClose(this.ref);
+    LevelDB.forgetRef(this.ref);
+    this.ref = undefined;
+  }
+
+  private static forgetRef(ref: undefined | number) {
+    g.leveldbClose(ref);
     for (const name in LevelDB.openPathRefs) {
-      if (LevelDB.openPathRefs[name] === this.ref) {
+      if (LevelDB.openPathRefs[name] === ref) {
         delete LevelDB.openPathRefs[name];
       }
     }
-    this.ref = undefined;
   }
 
   closed(): boolean {
@@ -212,6 +387,43 @@ export class LevelDB implements LevelDBI {
     return new LevelDBIterator(this.ref);
   }
 
+  clearRange(range?: LevelDBRange, batchSize: number = 1000): number {
+    return g.leveldbClearRange(this.ref, range, batchSize);
+  }
+
+  countRange(range?: LevelDBRange, limit?: number): number {
+    return g.leveldbCountRange(this.ref, range, limit || 0);
+  }
+
+  approximateSize(range?: LevelDBRange): number {
+    return g.leveldbApproximateSize(this.ref, range);
+  }
+
+  // Defines a secondary index called `name` and indexes all existing records. From then on, every write updates the
+  // index in the same atomic batch as the records. Re-creating an index with the same spec is a no-op; with a
+  // different spec, the index is rebuilt.
+  // Indexes are stored in the DB itself, under keys starting with the raw bytes 0xFF 0xFF followed by 'idx:' (only
+  // reachable with ArrayBuffer keys; the string '\xff' is stored as the two UTF-8 bytes 0xC3 0xBF). These keys are
+  // hidden from reads, iterators, countRange() etc., and writing them throws.
+  // Not supported on sharded DBs, whose writes are not atomic across shards.
+  createIndex(name: string, spec: LevelDBIndexSpec) {
+    g.leveldbCreateIndex(this.ref, name, spec);
+  }
+
+  dropIndex(name: string) {
+    g.leveldbDropIndex(this.ref, name);
+  }
+
+  // Returns the [key, value] records whose `name` index field lies within `query`, ordered by that field and then
+  // by key. The records are read in the same call, from the same snapshot as the index.
+  indexScanStr(name: string, query?: LevelDBIndexQuery, limit?: number): [string, string][] {
+    return g.leveldbIndexScan(this.ref, name, query, limit || 0, false);
+  }
+
+  indexScanBuf(name: string, query?: LevelDBIndexQuery, limit?: number): [ArrayBuffer, ArrayBuffer][] {
+    return g.leveldbIndexScan(this.ref, name, query, limit || 0, true);
+  }
+
   // Merges the data from another LevelDB into this one. All keys from src will be written into this LevelDB,
   // overwriting any existing values.
   // batchMerge=true will write all values from src in one transaction, thus ensuring that the dst DB is not left
@@ -240,4 +452,9 @@ export class LevelDB implements LevelDBI {
   }
 
   static readFileToBuf = g.leveldbReadFileBuf as (path: string, pos: number, len: number) => ArrayBuffer;
+
+  // Write or delete a file, e.g. a dump. Relative paths are relative to the documents directory, like for
+  // exportToFile(). Deleting a missing file is not an error.
+  static writeBufToFile = g.leveldbWriteFileBuf as (path: string, buf: ArrayBuffer) => void;
+  static deleteFile = g.leveldbDeleteFile as (path: string) => void;
 }